@@ -0,0 +1,527 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Expectimax search for the best placement. The current and next shapes
+ * are known; after that every shape still in the bag is equally likely.
+ * Positions are kept as one bit mask per row, and positions seen before
+ * (also during earlier decisions) are found in a Zobrist-hashed
+ * transposition table. Each deeper search is only started when there is
+ * time left, and its result is only used when it finishes in time.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "ai.h"
+
+/*
+ * Macros
+ */
+
+/* Playing field, without the walls */
+#define PLAYCOLS (NUMCOLS - 3)
+#define PLAYROWS (NUMROWS - 2)
+#define FULLROW ((1 << PLAYCOLS) - 1)
+
+/* Where shapes appear */
+#define SPAWNX 5
+#define SPAWNY 1
+
+/* Most placements a shape can have */
+#define MAXPLACEMENTS AI_MAXMOVES
+
+/* Placements looked at more closely below the top of the search */
+#define BEAM 8
+
+/* Bag with every shape in it */
+#define ALLSHAPES ((1 << NUMSHAPES) - 1)
+
+/* Shape unknown: the position is worth the average over the bag */
+#define UNKNOWN NUMSHAPES
+
+/* Value of a lost game */
+#define LOSS (-1e9)
+
+/* Entries in the transposition table */
+#define TABLESIZE (1 << 16)
+
+/* Nodes between looks at the clock */
+#define CLOCKCHECK 256
+
+/*
+ * Type definitions
+ */
+
+/* Playing field, one bit per cell, column 1 in bit 0 */
+typedef struct
+{
+   uint16_t row[PLAYROWS];
+   uint8_t surface[PLAYCOLS];	/* highest row with a block in each column, PLAYROWS if none */
+   uint64_t hash;
+} field_t;
+
+/* An orientation as masks */
+typedef struct
+{
+   int left,right;				/* smallest and largest x offset */
+   int top,bottom;				/* smallest and largest y offset */
+   unsigned int mask[NUMBLOCKS];	/* blocks in each row from the top, left block in bit 0 */
+} piece_t;
+
+typedef struct
+{
+   int orientation,rotations,x,y;
+} placement_t;
+
+typedef struct
+{
+   uint64_t key;
+   float value;
+   int depth;
+} entry_t;
+
+struct ai_struct
+{
+   weights_t weights;
+   piece_t piece[NUMORIENTATIONS];
+   uint64_t zcell[PLAYROWS][PLAYCOLS];
+   uint64_t zbag[ALLSHAPES + 1];
+   uint64_t zshape[NUMSHAPES + 1];
+   entry_t *table;
+   long long deadline;			/* give up at this time */
+   unsigned long nodes;
+   bool timed;					/* looking at the clock */
+   bool aborted;				/* out of time */
+};
+
+/*
+ * Global variables
+ */
+
+/* These come from El-Tetris by Islam El-Ashi */
+const weights_t AI_WEIGHTS =
+{
+   { -4.500158825082766, 3.4181268101392694, -3.2178882868487753, -9.348695305445199, -7.899265427351652, -3.3855972247263626 }
+};
+
+/*
+ * Positions
+ */
+
+/* Check if orientation o fits at (x,y) */
+static bool fits (const ai_t *ai,const field_t *field,int o,int x,int y)
+{
+   const piece_t *piece = &ai->piece[o];
+   int i,shift = x + piece->left - 1;
+   if (shift < 0 || x + piece->right > PLAYCOLS || y + piece->top < 0 || y + piece->bottom >= PLAYROWS) return FALSE;
+   for (i = 0; i <= piece->bottom - piece->top; i++)
+	 if (field->row[y + piece->top + i] & (piece->mask[i] << shift)) return FALSE;
+   return TRUE;
+}
+
+/* Zobrist hash of a field */
+static uint64_t hash (const ai_t *ai,const field_t *field)
+{
+   uint64_t h = 0;
+   unsigned int bits;
+   int y;
+   for (y = 0; y < PLAYROWS; y++)
+	 for (bits = field->row[y]; bits; bits &= bits - 1)
+	   h ^= ai->zcell[y][__builtin_ctz (bits)];
+   return (h);
+}
+
+/* Find the highest block in every column */
+static void find_surface (field_t *field)
+{
+   unsigned int seen = 0,bits;
+   int y;
+   memset (field->surface,PLAYROWS,sizeof (field->surface));
+   for (y = 0; y < PLAYROWS && seen != FULLROW; y++)
+	 {
+		for (bits = field->row[y] & ~seen; bits; bits &= bits - 1) field->surface[__builtin_ctz (bits)] = y;
+		seen |= field->row[y];
+	 }
+}
+
+/* Lowest row orientation o drops to from (x,y). Unless something hangs over it, that's where it meets the surface */
+static int drop (const ai_t *ai,const field_t *field,int o,int x,int y)
+{
+   const profile_t *profile = &PROFILES[o];
+   const uint8_t *surface = field->surface + x + profile->left - 1;
+   int i,land = PLAYROWS;
+   for (i = 0; i < profile->width; i++)
+	 {
+		if (y + profile->bottom[i] >= surface[i])
+		  {
+			 while (fits (ai,field,o,x,y + 1)) y++;
+			 return (y);
+		  }
+		if (surface[i] - 1 - profile->bottom[i] < land) land = surface[i] - 1 - profile->bottom[i];
+	 }
+   return (land);
+}
+
+/* Put orientation o at (x,y) and remove full rows. Returns the number of rows removed */
+static int place (const ai_t *ai,const field_t *field,int o,int x,int y,field_t *result)
+{
+   const piece_t *piece = &ai->piece[o];
+   int i,src,dst,lines = 0;
+   *result = *field;
+   for (i = 0; i <= piece->bottom - piece->top; i++)
+	 if ((result->row[y + piece->top + i] |= piece->mask[i] << (x + piece->left - 1)) == FULLROW) lines++;
+   if (!lines)
+	 {
+		for (i = 0; i < NUMBLOCKS; i++)
+		  result->hash ^= ai->zcell[y + ORIENTATIONS[o].block[i].y][x + ORIENTATIONS[o].block[i].x - 1];
+		for (i = 0; i < PROFILES[o].width; i++)
+		  if (y + PROFILES[o].top[i] < result->surface[x + PROFILES[o].left + i - 1])
+			result->surface[x + PROFILES[o].left + i - 1] = y + PROFILES[o].top[i];
+		return (0);
+	 }
+   for (src = dst = PLAYROWS - 1; src >= 0; src--)
+	 if (result->row[src] != FULLROW) result->row[dst--] = result->row[src];
+   while (dst >= 0) result->row[dst--] = 0;
+   result->hash = hash (ai,result);
+   find_surface (result);
+   return (lines);
+}
+
+/* Find every placement of a shape turned like orientation from at (x,y) */
+static int placements (const ai_t *ai,const field_t *field,int type,int from,int x,int y,placement_t *list)
+{
+   int first = FIRSTORIENTATION[type],n = FIRSTORIENTATION[type + 1] - first;
+   int i,k,o,dx,count = 0;
+   bool reachable;
+   if (!fits (ai,field,from,x,y)) return (0);
+   for (k = 0; k < n; k++)
+	 {
+		o = first + (from - first + k) % n;
+		/* Three clockwise rotations are one anticlockwise */
+		if (k == 3)
+		  reachable = fits (ai,field,o,x,y);
+		else
+		  for (reachable = TRUE, i = 1; i <= k && reachable; i++)
+			reachable = fits (ai,field,first + (from - first + i) % n,x,y);
+		if (!reachable) continue;
+		for (dx = -1; dx <= 1; dx += 2)
+		  {
+			 int px = dx < 0 ? x : x + 1,py;
+			 for (; fits (ai,field,o,px,y); px += dx)
+			   {
+				  py = drop (ai,field,o,px,y);
+				  list[count].orientation = o;
+				  list[count].rotations = k == 3 ? -1 : k;
+				  list[count].x = px;
+				  list[count].y = py;
+				  count++;
+			   }
+		  }
+	 }
+   return (count);
+}
+
+/*
+ * Evaluation
+ */
+
+/* What placing orientation o at height y and removing some lines is worth */
+static double reward (const ai_t *ai,int o,int y,int lines)
+{
+   const piece_t *piece = &ai->piece[o];
+   return (ai->weights.weight[FEATURE_LANDING] * (PLAYROWS - y - (piece->top + piece->bottom) / 2.0) +
+		   ai->weights.weight[FEATURE_LINES] * lines);
+}
+
+/* What a field is worth */
+static double evaluate (const ai_t *ai,const field_t *field)
+{
+   int y,x,rowtransitions = 0,coltransitions = 0,holes = 0,wells = 0;
+   unsigned int row,walled,well,cover = 0,above = 0,deep = 0,bits;
+   int depth[PLAYCOLS] = { 0 };
+   for (y = 0; y < PLAYROWS; y++)
+	 {
+		row = field->row[y];
+		walled = (row << 1) | 1 | (1 << (PLAYCOLS + 1));
+		rowtransitions += __builtin_popcount ((walled ^ (walled >> 1)) & ((1 << (PLAYCOLS + 1)) - 1));
+		coltransitions += __builtin_popcount (row ^ above);
+		holes += __builtin_popcount (~row & cover & FULLROW);
+		/* Empty cells with something on both sides */
+		well = ~row & walled & (walled >> 2) & FULLROW;
+		for (bits = well | deep; bits; bits &= bits - 1)
+		  {
+			 x = __builtin_ctz (bits);
+			 if (well & (1 << x)) wells += ++depth[x]; else depth[x] = 0;
+		  }
+		deep = well;
+		cover |= row;
+		above = row;
+	 }
+   coltransitions += __builtin_popcount (above ^ FULLROW);
+   return (ai->weights.weight[FEATURE_ROWTRANSITIONS] * rowtransitions +
+		   ai->weights.weight[FEATURE_COLTRANSITIONS] * coltransitions +
+		   ai->weights.weight[FEATURE_HOLES] * holes +
+		   ai->weights.weight[FEATURE_WELLS] * wells);
+}
+
+/*
+ * Search
+ */
+
+static double node (ai_t *ai,const field_t *field,int type,int bag,int depth);
+
+/* Best placement of a known shape, with depth shapes to go */
+static double maxnode (ai_t *ai,const field_t *field,int type,int bag,int depth)
+{
+   placement_t list[MAXPLACEMENTS];
+   field_t child[MAXPLACEMENTS];
+   double gain[MAXPLACEMENTS],value[MAXPLACEMENTS],best = LOSS,v;
+   int order[MAXPLACEMENTS],i,j,n,t;
+   n = placements (ai,field,type,FIRSTORIENTATION[type],SPAWNX,SPAWNY,list);
+   for (i = 0; i < n; i++)
+	 {
+		gain[i] = reward (ai,list[i].orientation,list[i].y,place (ai,field,list[i].orientation,list[i].x,list[i].y,&child[i]));
+		value[i] = gain[i] + evaluate (ai,&child[i]);
+		if (value[i] > best) best = value[i];
+	 }
+   if (depth == 1) return (best);
+   /* Only look further at the most promising ones */
+   for (i = 0; i < n; i++)
+	 {
+		for (j = i; j > 0 && value[order[j - 1]] < value[i]; j--) order[j] = order[j - 1];
+		order[j] = i;
+	 }
+   for (best = LOSS, i = 0; i < n && i < BEAM; i++)
+	 {
+		t = order[i];
+		v = gain[t] + node (ai,&child[t],UNKNOWN,bag,depth - 1);
+		if (v > best) best = v;
+	 }
+   return (best);
+}
+
+/* Average over the shapes the bag may give */
+static double chancenode (ai_t *ai,const field_t *field,int bag,int depth)
+{
+   double total = 0;
+   int type,rest,count = 0;
+   for (type = 0; type < NUMSHAPES; type++)
+	 if (bag & (1 << type))
+	   {
+		  rest = bag & ~(1 << type);
+		  total += maxnode (ai,field,type,rest ? rest : ALLSHAPES,depth);
+		  count++;
+	   }
+   return (total / count);
+}
+
+/* Value of a field where type (or UNKNOWN) comes next, the bag holds bag, and depth shapes are to be placed */
+static double node (ai_t *ai,const field_t *field,int type,int bag,int depth)
+{
+   uint64_t key;
+   entry_t *entry;
+   double value;
+   if (depth == 0) return (evaluate (ai,field));
+   if (ai->timed && ++ai->nodes % CLOCKCHECK == 0 && microseconds () > ai->deadline) ai->aborted = TRUE;
+   if (ai->aborted) return (0);
+   key = field->hash ^ ai->zbag[bag] ^ ai->zshape[type];
+   entry = &ai->table[key & (TABLESIZE - 1)];
+   if (entry->key == key && entry->depth == depth) return (entry->value);
+   value = type == UNKNOWN ? chancenode (ai,field,bag,depth) : maxnode (ai,field,type,bag,depth);
+   if (!ai->aborted)
+	 {
+		entry->key = key;
+		entry->value = value;
+		entry->depth = depth;
+	 }
+   return (value);
+}
+
+/*
+ * Functions
+ */
+
+/* Create an AI */
+ai_t *ai_new (const weights_t *weights)
+{
+   ai_t *ai;
+   uint64_t state = 0x7465747269735eedULL;
+   int o,i,x,y;
+   if ((ai = calloc (1,sizeof (ai_t))) == NULL) return (NULL);
+   if ((ai->table = calloc (TABLESIZE,sizeof (entry_t))) == NULL)
+	 {
+		free (ai);
+		return (NULL);
+	 }
+   ai->weights = *weights;
+   for (o = 0; o < NUMORIENTATIONS; o++)
+	 {
+		piece_t *piece = &ai->piece[o];
+		const block_t *block = ORIENTATIONS[o].block;
+		piece->left = piece->right = block[0].x;
+		piece->top = piece->bottom = block[0].y;
+		for (i = 1; i < NUMBLOCKS; i++)
+		  {
+			 if (block[i].x < piece->left) piece->left = block[i].x;
+			 if (block[i].x > piece->right) piece->right = block[i].x;
+			 if (block[i].y < piece->top) piece->top = block[i].y;
+			 if (block[i].y > piece->bottom) piece->bottom = block[i].y;
+		  }
+		for (i = 0; i < NUMBLOCKS; i++)
+		  piece->mask[block[i].y - piece->top] |= 1 << (block[i].x - piece->left);
+	 }
+   /* Zobrist keys, made of three 31-bit random numbers each */
+#define KEY() (((uint64_t) rand_next (&state,INT32_MAX) << 33) ^ ((uint64_t) rand_next (&state,INT32_MAX) << 11) ^ (uint64_t) rand_next (&state,INT32_MAX))
+   for (y = 0; y < PLAYROWS; y++) for (x = 0; x < PLAYCOLS; x++) ai->zcell[y][x] = KEY ();
+   for (i = 0; i <= ALLSHAPES; i++) ai->zbag[i] = KEY ();
+   for (i = 0; i <= NUMSHAPES; i++) ai->zshape[i] = KEY ();
+#undef KEY
+   return (ai);
+}
+
+/* Free an AI */
+void ai_free (ai_t *ai)
+{
+   free (ai->table);
+   free (ai);
+}
+
+/* The field of an engine without the current shape (and its shadow) */
+static void snapshot (const ai_t *ai,const engine_t *engine,field_t *field)
+{
+   const shape_t *shape = &engine->shapes[engine->curshape];
+   int i,x,y;
+   memset (field,0,sizeof (field_t));
+   for (y = 0; y < PLAYROWS; y++) for (x = 1; x <= PLAYCOLS; x++)
+	 if (engine->board[x][y]) field->row[y] |= 1 << (x - 1);
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		field->row[engine->cury + shape->block[i].y] &= ~(1 << (engine->curx + shape->block[i].x - 1));
+		if (engine->shadow) field->row[engine->cury_shadow + shape->block[i].y] &= ~(1 << (engine->curx_shadow + shape->block[i].x - 1));
+	 }
+   field->hash = hash (ai,field);
+   /* The engine keeps track of the surface too */
+   for (x = 1; x <= PLAYCOLS; x++) field->surface[x - 1] = engine->surface[x];
+}
+
+/* Choose a placement for the current shape */
+bool ai_choose (ai_t *ai,const engine_t *engine,long budget,int maxdepth,ai_move_t *move)
+{
+   placement_t list[MAXPLACEMENTS];
+   field_t field,child[MAXPLACEMENTS];
+   double gain[MAXPLACEMENTS],value,best = LOSS;
+   int i,n,depth,chosen,bag = ALLSHAPES;
+   snapshot (ai,engine,&field);
+   if (!(n = placements (ai,&field,engine->curshape,engine->orientation,engine->curx,engine->cury,list))) return (FALSE);
+   /* What's left in the bag once the next shape is out: the ones we haven't seen */
+   for (i = 0; i <= engine->bag_iterator % NUMSHAPES; i++) bag &= ~(1 << engine->bag[i]);
+   if (!bag) bag = ALLSHAPES;
+   for (i = 0; i < n; i++) gain[i] = reward (ai,list[i].orientation,list[i].y,place (ai,&field,list[i].orientation,list[i].x,list[i].y,&child[i]));
+   ai->deadline = microseconds () + budget;
+   ai->aborted = FALSE;
+   for (depth = 1; depth <= maxdepth; depth++)
+	 {
+		/* The first search always finishes */
+		ai->timed = depth > 1 && budget > 0;
+		for (chosen = -1, i = 0; i < n && !ai->aborted; i++)
+		  {
+			 value = gain[i] + (depth == 1 ? evaluate (ai,&child[i]) : node (ai,&child[i],engine->nextshape,bag,depth - 1));
+			 if (chosen < 0 || value > best) best = value, chosen = i;
+		  }
+		if (ai->aborted) break;
+		move->orientation = list[chosen].orientation;
+		move->rotations = list[chosen].rotations;
+		move->x = list[chosen].x;
+		move->y = list[chosen].y;
+		move->depth = depth;
+		move->value = best;
+	 }
+   return (TRUE);
+}
+
+/* List every placement of the current shape */
+int ai_placements (ai_t *ai,const engine_t *engine,ai_move_t *moves)
+{
+   placement_t list[MAXPLACEMENTS];
+   field_t field,child;
+   int i,n;
+   snapshot (ai,engine,&field);
+   n = placements (ai,&field,engine->curshape,engine->orientation,engine->curx,engine->cury,list);
+   for (i = 0; i < n; i++)
+	 {
+		moves[i].orientation = list[i].orientation;
+		moves[i].rotations = list[i].rotations;
+		moves[i].x = list[i].x;
+		moves[i].y = list[i].y;
+		moves[i].depth = 1;
+		moves[i].value = reward (ai,list[i].orientation,list[i].y,place (ai,&field,list[i].orientation,list[i].x,list[i].y,&child)) + evaluate (ai,&child);
+	 }
+   return (n);
+}
+
+/* What the AI thinks of the blocks at rest */
+double ai_evaluate (ai_t *ai,const engine_t *engine)
+{
+   field_t field;
+   snapshot (ai,engine,&field);
+   return (evaluate (ai,&field));
+}
+
+/* Move the current shape to where a move says and drop it */
+int ai_apply (engine_t *engine,const ai_move_t *move)
+{
+   int i;
+   for (i = 0; i < move->rotations; i++) engine_move (engine,ACTION_ROTATE_CLOCKWISE);
+   if (move->rotations < 0) engine_move (engine,ACTION_ROTATE_COUNTERCLOCKWISE);
+   for (i = engine->curx; i > move->x; i--) engine_move (engine,ACTION_LEFT);
+   for (i = engine->curx; i < move->x; i++) engine_move (engine,ACTION_RIGHT);
+   engine_move (engine,ACTION_DROP);
+   return (engine_evaluate (engine));
+}
+
+/* Put the current shape where the AI wants it and drop it */
+int ai_play (ai_t *ai,engine_t *engine,long budget,int maxdepth)
+{
+   ai_move_t move;
+   if (!ai_choose (ai,engine,budget,maxdepth,&move)) return (-1);
+   return (ai_apply (engine,&move));
+}
+
+/* Use other weights from now on */
+void ai_weights (ai_t *ai,const weights_t *weights)
+{
+   ai->weights = *weights;
+   /* What we know about positions was worked out with the old ones */
+   memset (ai->table,0,TABLESIZE * sizeof (entry_t));
+}
@@ -0,0 +1,137 @@
+#ifndef AI_H
+#define AI_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t */
+
+/*
+ * Macros
+ */
+
+/* Shapes the AI looks ahead when time allows, counting the current one */
+#define AI_MAXDEPTH 3
+
+/* Most placements a shape can have */
+#define AI_MAXMOVES (4 * (NUMCOLS - 3))
+
+/*
+ * Type definitions
+ */
+
+/* What the AI looks at when judging a placement */
+typedef enum
+{
+   FEATURE_LANDING,				/* height the shape lands at */
+   FEATURE_LINES,				/* lines it removes */
+   FEATURE_ROWTRANSITIONS,		/* filled/empty changes along the rows */
+   FEATURE_COLTRANSITIONS,		/* filled/empty changes down the columns */
+   FEATURE_HOLES,				/* empty cells with something above them */
+   FEATURE_WELLS,				/* depth of gaps between columns */
+   NUMFEATURES
+} feature_t;
+
+typedef struct
+{
+   double weight[NUMFEATURES];
+} weights_t;
+
+/* Where the AI wants the current shape */
+typedef struct
+{
+   int orientation;				/* index in ORIENTATIONS */
+   int rotations;				/* clockwise rotations to get there, -1 for one anticlockwise */
+   int x,y;						/* where it lands */
+   int depth;					/* shapes searched, counting this one */
+   double value;				/* how good it is */
+} ai_move_t;
+
+typedef struct ai_struct ai_t;
+
+/*
+ * Global variables
+ */
+
+/* Weights that play well */
+extern const weights_t AI_WEIGHTS;
+
+/*
+ * Functions
+ */
+
+/*
+ * Create an AI. Returns NULL if we run out of memory
+ */
+ai_t *ai_new (const weights_t *weights);
+
+/*
+ * Free an AI
+ */
+void ai_free (ai_t *ai);
+
+/*
+ * Choose a placement for the current shape of engine. Searches up to
+ * maxdepth shapes ahead, averaging over the shapes the bag can still
+ * hold, but gives the best placement found so far once budget
+ * microseconds have passed (0 for no limit). Returns FALSE if the shape
+ * can't be placed
+ */
+bool ai_choose (ai_t *ai,const engine_t *engine,long budget,int maxdepth,ai_move_t *move);
+
+/*
+ * List every placement of the current shape of engine, with what it's
+ * worth without looking ahead. moves must have room for AI_MAXMOVES.
+ * Returns the number of placements, 0 if the game is over
+ */
+int ai_placements (ai_t *ai,const engine_t *engine,ai_move_t *moves);
+
+/*
+ * What the AI thinks of the blocks at rest in engine (higher is better)
+ */
+double ai_evaluate (ai_t *ai,const engine_t *engine);
+
+/*
+ * Move the current shape of engine where move says and drop it.
+ * Returns what engine_evaluate () returns
+ */
+int ai_apply (engine_t *engine,const ai_move_t *move);
+
+/*
+ * Put the current shape where ai_choose () wants it and drop it.
+ * Returns what engine_evaluate () returns, -1 if the game is over
+ */
+int ai_play (ai_t *ai,engine_t *engine,long budget,int maxdepth);
+
+/*
+ * Use other weights from now on
+ */
+void ai_weights (ai_t *ai,const weights_t *weights);
+
+#endif	/* #ifndef AI_H */
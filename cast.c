@@ -0,0 +1,146 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Session recorder. The ansi backend hands us every frame it writes to
+ * the terminal; we turn it into an asciicast event and append it to a
+ * spool, so the game never waits for the disk. A frame that doesn't fit
+ * is dropped, and since the frames only hold what changed, the next one
+ * is replaced by the whole screen.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "io.h"
+#include "spool.h"
+#include "cast.h"
+
+/*
+ * Macros
+ */
+
+/* Size of each of the two buffers */
+#define BUFSIZE 262144
+
+/* Bytes of an event besides the escaped frame */
+#define EVENTSIZE 32
+
+/*
+ * Global variables
+ */
+
+static spool_t *spool;
+static unsigned long dropped;
+
+/* When the recording started, and whether the next frame has to be the whole screen */
+static long long started;
+static bool resync;
+
+/*
+ * Functions
+ */
+
+/* Append a frame as an output event, with everything JSON can't hold in a string escaped */
+static void event (void *arg,const char *frame,size_t len)
+{
+   static const char hex[] = "0123456789abcdef";
+   double t = (microseconds () - started) / 1e6;
+   unsigned char ch;
+   char *p,*start;
+   size_t i;
+   /* Assume the worst, which is six bytes for every one of the frame */
+   if ((p = start = spool_reserve (spool,len * 6 + EVENTSIZE)) == NULL)
+	 {
+		dropped++;
+		resync = TRUE;
+		return;
+	 }
+   p += sprintf (p,"[%.6f, \"o\", \"",t);
+   for (i = 0; i < len; i++)
+	 {
+		ch = frame[i];
+		if (ch == '"' || ch == '\\')
+		  *p++ = '\\', *p++ = ch;
+		else if (ch < 0x20 || ch >= 0x7f)
+		  p += sprintf (p,"\\u00%c%c",hex[ch >> 4],hex[ch & 15]);
+		else
+		  *p++ = ch;
+	 }
+   p += sprintf (p,"\"]\n");
+   spool_commit (spool,p - start);
+}
+
+/* Record a frame of our terminal, or all of it if frames were lost */
+static void frame (void *arg,const char *frame,size_t len)
+{
+   if (!resync)
+	 event (arg,frame,len);
+   else
+	 {
+		resync = FALSE;
+		ansi_keyframe (NULL,event,arg);
+	 }
+}
+
+/* Create a recording */
+bool cast_open (const char *filename)
+{
+   return ((spool = spool_open (filename,BUFSIZE)) != NULL);
+}
+
+/* Start recording our terminal */
+void cast_start ()
+{
+   const char *term = getenv ("TERM");
+   char header[256];
+   if (spool == NULL) return;
+   snprintf (header,sizeof (header),"{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %ld, \"env\": {\"TERM\": \"%s\"}}\n",
+			 out_width (),out_height (),(long) time (NULL),term != NULL && strpbrk (term,"\"\\") == NULL ? term : "xterm");
+   spool_write (spool,header,strlen (header));
+   /* The screen has been set up already, so start with all of it */
+   started = microseconds ();
+   resync = TRUE;
+   ansi_tap (frame,NULL);
+}
+
+/* Write what's left and close the recording */
+void cast_close ()
+{
+   if (spool == NULL) return;
+   ansi_tap (NULL,NULL);
+   spool_close (spool);
+   spool = NULL;
+   if (dropped) fprintf (stderr,"record: %lu frames dropped\n",dropped);
+}
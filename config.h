@@ -32,4 +32,7 @@
 /* Score file */
 const char scorefile[] = SCOREFILE;
 
+/* Socket the score daemon listens on */
+const char scoresocket[] = SCORESOCKET;
+
 #endif	/* #ifndef CONFIG_H */
@@ -27,6 +27,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -34,6 +35,7 @@
 #include "utils.h"
 #include "io.h"
 #include "engine.h"
+#include "profile.h"
 
 /*
  * Global variables
@@ -41,19 +43,129 @@
 
 const shapes_t SHAPES =
 {
-   { COLOR_CYAN,    0, FALSE, { {  1,  0 }, {  0,  0 }, {  0, -1 }, { -1, -1 } } },
-   { COLOR_GREEN,   1, FALSE, { {  1, -1 }, {  0, -1 }, {  0,  0 }, { -1,  0 } } },
-   { COLOR_YELLOW,  2, FALSE, { { -1,  0 }, {  0,  0 }, {  1,  0 }, {  0,  1 } } },
-   { COLOR_BLUE,    3, FALSE, { { -1, -1 }, {  0, -1 }, { -1,  0 }, {  0,  0 } } },
-   { COLOR_MAGENTA, 4, FALSE, { { -1,  1 }, { -1,  0 }, {  0,  0 }, {  1,  0 } } },
-   { COLOR_WHITE,   5, FALSE, { {  1,  1 }, {  1,  0 }, {  0,  0 }, { -1,  0 } } },
-   { COLOR_RED,     6, FALSE, { { -1,  0 }, {  0,  0 }, {  1,  0 }, {  2,  0 } } }
+   { COLOR_CYAN,    0, FALSE, { {  1,  0 }, {  0,  0 }, {  0, -1 }, { -1, -1 } },  0 },
+   { COLOR_GREEN,   1, FALSE, { {  1, -1 }, {  0, -1 }, {  0,  0 }, { -1,  0 } },  2 },
+   { COLOR_YELLOW,  2, FALSE, { { -1,  0 }, {  0,  0 }, {  1,  0 }, {  0,  1 } },  4 },
+   { COLOR_BLUE,    3, FALSE, { { -1, -1 }, {  0, -1 }, { -1,  0 }, {  0,  0 } },  8 },
+   { COLOR_MAGENTA, 4, FALSE, { { -1,  1 }, { -1,  0 }, {  0,  0 }, {  1,  0 } },  9 },
+   { COLOR_WHITE,   5, FALSE, { {  1,  1 }, {  1,  0 }, {  0,  0 }, { -1,  0 } }, 13 },
+   { COLOR_RED,     6, FALSE, { { -1,  0 }, {  0,  0 }, {  1,  0 }, {  2,  0 } }, 17 }
 };
 
+/*
+ * What fake_rotate () does to SHAPES when rotating clockwise, as
+ * O (index, type, rotations, x and y of each block). The ORIENTATIONS
+ * table and the collision kernels below are both made from this
+ */
+#define EACH_ORIENTATION(O) \
+   O ( 0, 0, 0,  1,  0,  0,  0,  0, -1, -1, -1) \
+   O ( 1, 0, 1,  0, -1,  0,  0, -1,  0, -1,  1) \
+   O ( 2, 1, 0,  1, -1,  0, -1,  0,  0, -1,  0) \
+   O ( 3, 1, 1,  1,  1,  1,  0,  0,  0,  0, -1) \
+   O ( 4, 2, 0, -1,  0,  0,  0,  1,  0,  0,  1) \
+   O ( 5, 2, 1,  0, -1,  0,  0,  0,  1, -1,  0) \
+   O ( 6, 2, 2,  1,  0,  0,  0, -1,  0,  0, -1) \
+   O ( 7, 2, 3,  0,  1,  0,  0,  0, -1,  1,  0) \
+   O ( 8, 3, 0, -1, -1,  0, -1, -1,  0,  0,  0) \
+   O ( 9, 4, 0, -1,  1, -1,  0,  0,  0,  1,  0) \
+   O (10, 4, 1, -1, -1,  0, -1,  0,  0,  0,  1) \
+   O (11, 4, 2,  1, -1,  1,  0,  0,  0, -1,  0) \
+   O (12, 4, 3,  1,  1,  0,  1,  0,  0,  0, -1) \
+   O (13, 5, 0,  1,  1,  1,  0,  0,  0, -1,  0) \
+   O (14, 5, 1, -1,  1,  0,  1,  0,  0,  0, -1) \
+   O (15, 5, 2, -1, -1, -1,  0,  0,  0,  1,  0) \
+   O (16, 5, 3,  1, -1,  0, -1,  0,  0,  0,  1) \
+   O (17, 6, 0, -1,  0,  0,  0,  1,  0,  2,  0) \
+   O (18, 6, 1,  0, -1,  0,  0,  0,  1,  0,  2)
+
+#define ORIENTATION(n,type,rotations,x0,y0,x1,y1,x2,y2,x3,y3) { type, rotations, { { x0, y0 }, { x1, y1 }, { x2, y2 }, { x3, y3 } } },
+const orientation_t ORIENTATIONS[NUMORIENTATIONS] = { EACH_ORIENTATION (ORIENTATION) };
+#undef ORIENTATION
+
+const int FIRSTORIENTATION[NUMSHAPES + 1] = { 0, 2, 4, 8, 9, 13, 17, 19 };
+
+/* The columns of ORIENTATIONS */
+const profile_t PROFILES[NUMORIENTATIONS] =
+{
+   { -1, 3, { -1,  0,  0,  0 }, { -1, -1,  0,  0 } },
+   { -1, 2, {  1,  0,  0,  0 }, {  0, -1,  0,  0 } },
+   { -1, 3, {  0,  0, -1,  0 }, {  0, -1, -1,  0 } },
+   {  0, 2, {  0,  1,  0,  0 }, { -1,  0,  0,  0 } },
+   { -1, 3, {  0,  1,  0,  0 }, {  0,  0,  0,  0 } },
+   { -1, 2, {  0,  1,  0,  0 }, {  0, -1,  0,  0 } },
+   { -1, 3, {  0,  0,  0,  0 }, {  0, -1,  0,  0 } },
+   {  0, 2, {  1,  0,  0,  0 }, { -1,  0,  0,  0 } },
+   { -1, 2, {  0,  0,  0,  0 }, { -1, -1,  0,  0 } },
+   { -1, 3, {  1,  0,  0,  0 }, {  0,  0,  0,  0 } },
+   { -1, 2, { -1,  1,  0,  0 }, { -1, -1,  0,  0 } },
+   { -1, 3, {  0,  0,  0,  0 }, {  0,  0, -1,  0 } },
+   {  0, 2, {  1,  1,  0,  0 }, { -1,  1,  0,  0 } },
+   { -1, 3, {  0,  0,  1,  0 }, {  0,  0,  0,  0 } },
+   { -1, 2, {  1,  1,  0,  0 }, {  1, -1,  0,  0 } },
+   { -1, 3, {  0,  0,  0,  0 }, { -1,  0,  0,  0 } },
+   {  0, 2, {  1, -1,  0,  0 }, { -1, -1,  0,  0 } },
+   { -1, 4, {  0,  0,  0,  0 }, {  0,  0,  0,  0 } },
+   {  0, 1, {  2,  0,  0,  0 }, { -1,  0,  0,  0 } }
+};
+
+/*
+ * Zobrist keys. Each key is a fixed function of what it stands for, so
+ * the same position hashes the same in every process and on every
+ * platform, without a table to set up
+ */
+
+#define ZCELL(x,y)		zobrist ((x) * NUMROWS + (y))
+#define ZPIECE(o,x,y)	zobrist (((1 + (o)) * NUMCOLS + (x)) * NUMROWS + (y))
+#define ZNEXT(type)		zobrist ((1 + NUMORIENTATIONS) * NUMCOLS * NUMROWS + (type))
+#define ZBAG(bag)		zobrist ((1 + NUMORIENTATIONS) * NUMCOLS * NUMROWS + NUMSHAPES + (bag))
+
+/*
+ * With CHECKHASH defined, every change to the engine checks that the
+ * hash kept up to date is the one computed from scratch
+ */
+#ifdef CHECKHASH
+#define CHECK_HASH(engine) check_hash (engine,__func__)
+#else
+#define CHECK_HASH(engine)
+#endif
+
 /*
  * Functions
  */
 
+#ifdef CHECKHASH
+static void check_hash (const engine_t *engine,const char *caller)
+{
+   uint64_t hash = engine_hash (engine);
+   if (engine->hash == hash) return;
+   fprintf (stderr,"%s: hash is %016llx, should be %016llx\n",caller,(unsigned long long) engine->hash,(unsigned long long) hash);
+   abort ();
+}
+#endif
+
+/* Key number n (splitmix64 of n) */
+static inline uint64_t zobrist (uint64_t n)
+{
+   n = (n + 1) * 0x9e3779b97f4a7c15ULL;
+   n = (n ^ (n >> 30)) * 0xbf58476d1ce4e5b9ULL;
+   n = (n ^ (n >> 27)) * 0x94d049bb133111ebULL;
+   return (n ^ (n >> 31));
+}
+
+/* Shapes still in the bag once the next one is out */
+static int bagmask (const engine_t *engine)
+{
+   int i,bag = 0;
+   for (i = engine->bag_iterator % NUMSHAPES + 1; i < NUMSHAPES; i++) bag |= 1 << engine->bag[i];
+   return (bag);
+}
+
+/* Hash the current shape at (x,y) turned like orientation instead of where it is now */
+static void hash_piece (engine_t *engine,int orientation,int x,int y)
+{
+   engine->hash ^= ZPIECE (engine->orientation,engine->curx,engine->cury) ^ ZPIECE (orientation,x,y);
+}
+
 /* This rotates a shape */
 static void real_rotate (shape_t *shape,bool clockwise)
 {
@@ -100,32 +212,67 @@ static void fake_rotate (shape_t *shape,bool clockwise)
 	  case 3:	/* This one is not rotated at all */
 		break;
 	 }
+   shape->orientation = engine_orientation (shape);
 }
 
+/*
+ * Kernels. Every orientation gets its own collision check, stamp and
+ * erase, with the block offsets as constants and no loop, picked from a
+ * table by the orientation of the shape
+ */
+
+#define CELL(dx,dy) board[x + (dx)][y + (dy)]
+
+#define KERNEL_FUNCTIONS(n,type,rotations,x0,y0,x1,y1,x2,y2,x3,y3) \
+static bool allowed_##n (board_t board,int x,int y) \
+{ \
+   return (!(CELL (x0,y0) | CELL (x1,y1) | CELL (x2,y2) | CELL (x3,y3))); \
+} \
+static void stamp_##n (board_t board,int x,int y,int color) \
+{ \
+   CELL (x0,y0) = CELL (x1,y1) = CELL (x2,y2) = CELL (x3,y3) = color; \
+} \
+static void unstamp_##n (board_t board,int x,int y) \
+{ \
+   CELL (x0,y0) = CELL (x1,y1) = CELL (x2,y2) = CELL (x3,y3) = COLOR_BLACK; \
+}
+
+EACH_ORIENTATION (KERNEL_FUNCTIONS)
+
+#define KERNEL_ENTRY(n,type,rotations,x0,y0,x1,y1,x2,y2,x3,y3) { allowed_##n, stamp_##n, unstamp_##n },
+
+static const struct
+{
+   bool (*allowed) (board_t board,int x,int y);
+   void (*stamp) (board_t board,int x,int y,int color);
+   void (*unstamp) (board_t board,int x,int y);
+} KERNELS[NUMORIENTATIONS] = { EACH_ORIENTATION (KERNEL_ENTRY) };
+
+#undef KERNEL_ENTRY
+#undef KERNEL_FUNCTIONS
+#undef CELL
+
 /* Draw a shape on the board */
-static void drawshape (board_t board,shape_t *shape,int x,int y)
+static inline void drawshape (board_t board,shape_t *shape,int x,int y)
 {
-   int i;
-   for (i = 0; i < NUMBLOCKS; i++) board[x + shape->block[i].x][y + shape->block[i].y] = shape->color;
+   KERNELS[shape->orientation].stamp (board,x,y,shape->color);
 }
 
 /* Erase a shape from the board */
-static void eraseshape (board_t board,shape_t *shape,int x,int y)
+static inline void eraseshape (board_t board,shape_t *shape,int x,int y)
 {
-   int i;
-   for (i = 0; i < NUMBLOCKS; i++) board[x + shape->block[i].x][y + shape->block[i].y] = COLOR_BLACK;
+   KERNELS[shape->orientation].unstamp (board,x,y);
 }
 
 /* Check if shape is allowed to be in this position */
-static bool allowed (board_t board,shape_t *shape,int x,int y)
+static inline bool allowed (board_t board,shape_t *shape,int x,int y)
 {
-   int i,occupied = FALSE;
-   for (i = 0; i < NUMBLOCKS; i++) if (board[x + shape->block[i].x][y + shape->block[i].y]) occupied = TRUE;
-   return (!occupied);
+   return (KERNELS[shape->orientation].allowed (board,x,y));
 }
 
 /* Set y coordinate of shadow */
 static void place_shadow_to_bottom (board_t board,shape_t *shape,int x_shadow,int *y_shadow,int y) {
+   PROFILE_ZONE (ZONE_SHADOW);
    while (allowed(board,shape,x_shadow,y+1)) y++;
    *y_shadow = y;
 }
@@ -140,6 +287,7 @@ static bool shape_left (engine_t *engine)
    if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
    if (allowed (*board,shape,engine->curx - 1,engine->cury))
 	 {
+		hash_piece (engine,engine->orientation,engine->curx - 1,engine->cury);
         engine->curx--;
         result = TRUE;
         if (engine->shadow)
@@ -163,6 +311,7 @@ static bool shape_right (engine_t *engine)
    if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
    if (allowed (*board,shape,engine->curx + 1,engine->cury))
 	 {
+		hash_piece (engine,engine->orientation,engine->curx + 1,engine->cury);
 		engine->curx++;
 		result = TRUE;
 		if (engine->shadow)
@@ -190,6 +339,8 @@ static bool shape_rotate (engine_t *engine,bool clockwise)
    if (allowed (*board,&test,engine->curx,engine->cury))
 	 {
 		memcpy (shape,&test,sizeof (shape_t));
+		hash_piece (engine,shape->orientation,engine->curx,engine->cury);
+		engine->orientation = shape->orientation;
 		result = TRUE;
 		if (engine->shadow) place_shadow_to_bottom(*board,shape,engine->curx_shadow,&engine->cury_shadow,engine->cury);
 	 }
@@ -208,6 +359,7 @@ static bool shape_down (engine_t *engine)
    if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
    if (allowed (*board,shape,engine->curx,engine->cury + 1))
 	 {
+		hash_piece (engine,engine->orientation,engine->curx,engine->cury + 1);
 		engine->cury++;
 		result = TRUE;
 		if (engine->shadow) place_shadow_to_bottom(*board,shape,engine->curx_shadow,&engine->cury_shadow,engine->cury);
@@ -232,6 +384,31 @@ static bool shape_bottom (engine_t *engine)
    return result;
 }
 
+/* Row the current shape comes to rest on, from the surface alone. Returns -1 if the shape is below the surface somewhere */
+static int landing (const engine_t *engine)
+{
+   const profile_t *profile = &PROFILES[engine->orientation];
+   const int *surface = engine->surface + engine->curx + profile->left;
+   int i,y = NUMROWS;
+   for (i = 0; i < profile->width; i++)
+	 {
+		if (engine->cury + profile->bottom[i] >= surface[i]) return (-1);
+		if (surface[i] - 1 - profile->bottom[i] < y) y = surface[i] - 1 - profile->bottom[i];
+	 }
+   return (y);
+}
+
+/* Find the highest block in every column */
+static void find_surface (engine_t *engine)
+{
+   int x,y;
+   for (x = 0; x < NUMCOLS; x++)
+	 {
+		for (y = 0; !engine->board[x][y]; y++) ;
+		engine->surface[x] = y;
+	 }
+}
+
 /* Drop the shape until it comes to rest on the bottom of the board or */
 /* on top of a resting shape */
 static int shape_drop (engine_t *engine)
@@ -239,29 +416,31 @@ static int shape_drop (engine_t *engine)
    board_t *board = &engine->board;
    shape_t *shape = &engine->shapes[engine->curshape];
    eraseshape (*board,shape,engine->curx,engine->cury);
-   int droppedlines = 0;
+   int droppedlines = 0,y;
 
-   if (engine->shadow) {
-       drawshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
-       droppedlines = engine->cury_shadow - engine->cury;
-       engine->cury = engine->cury_shadow;
-       return droppedlines;
-   }
+   /* The shadow isn't placed until the shape first moves, so don't count on it */
+   if (engine->shadow) eraseshape (*board,shape,engine->curx_shadow,engine->cury_shadow);
 
-   while (allowed (*board,shape,engine->curx,engine->cury + 1))
-	 {
-		engine->cury++;
-		droppedlines++;
-	 }
+   /* Only when something hangs over the shape does it have to feel its way down */
+   if ((y = landing (engine)) >= 0)
+	 droppedlines = y - engine->cury;
+   else
+	 while (allowed (*board,shape,engine->curx,engine->cury + droppedlines + 1)) droppedlines++;
+   hash_piece (engine,engine->orientation,engine->curx,engine->cury + droppedlines);
+   engine->cury += droppedlines;
+   engine->curx_shadow = engine->curx;
+   engine->cury_shadow = engine->cury;
    drawshape (*board,shape,engine->curx,engine->cury);
    return droppedlines;
 }
 
 /* This removes all the rows on the board that is completely filled with blocks */
-static int droplines (board_t board)
+static int droplines (engine_t *engine)
 {
    int i,x,y,ny,status,droppedlines;
+   int (*board)[NUMROWS] = engine->board;
    board_t newboard;
+   PROFILE_ZONE (ZONE_DROPLINES);
    /* initialize new board */
    memset (newboard,0,sizeof (board_t));
    for (i = 0; i < NUMCOLS; i++) newboard[i][NUMROWS - 1] = newboard[i][NUMROWS - 2] = WALL;
@@ -276,22 +455,30 @@ static int droplines (board_t board)
 		if (status < NUMCOLS - 3)
 		  {
 			 for (x = 1; x < NUMCOLS - 2; x++) newboard[x][ny] = board[x][y];
+			 /* Only rows that move change the hash */
+			 if (ny != y) for (x = 1; x < NUMCOLS - 2; x++) if (board[x][y]) engine->hash ^= ZCELL (x,y) ^ ZCELL (x,ny);
 			 ny--;
 		  }
-		else droppedlines++;
+		else
+		  {
+			 for (x = 1; x < NUMCOLS - 2; x++) engine->hash ^= ZCELL (x,y);
+			 droppedlines++;
+		  }
 	 }
+   /* The top row isn't copied */
+   for (x = 1; x < NUMCOLS - 2; x++) if (board[x][0]) engine->hash ^= ZCELL (x,0);
    memcpy (board,newboard,sizeof (board_t));
    return droppedlines;
 }
 
 /* shuffle int array */
-void shuffle (int *array, size_t n)
+static void shuffle (uint64_t *rng,int *array, size_t n)
 {
    size_t i;
    for (i = 0; i < n - 1; i++)
    {
       int range = (int)(n - i);
-      size_t j = i + rand_value(range);
+	  size_t j = i + rand_next(rng,range);
       int t = array[j];
       array[j] = array[i];
       array[i] = t;
@@ -301,11 +488,13 @@ void shuffle (int *array, size_t n)
 /*
  * Initialize specified tetris engine
  */
-void engine_init (engine_t *engine,void (*score_function)(engine_t *))
+void engine_init (engine_t *engine,unsigned int seed,void (*score_function)(engine_t *),void *data)
 {
    int i;
    engine->shadow = FALSE;
    engine->score_function = score_function;
+   engine->data = data;
+   engine->rng = seed;
    /* intialize values */
    engine->curx = 5;
    engine->cury = 1;
@@ -314,10 +503,11 @@ void engine_init (engine_t *engine,void (*score_function)(engine_t *))
    engine->bag_iterator = 0;
    /* create and randomize bag */
    for (int j = 0; j < NUMSHAPES; j++) engine->bag[j] = j;
-   shuffle (engine->bag,NUMSHAPES);
+   shuffle (&engine->rng,engine->bag,NUMSHAPES);
    engine->curshape = engine->bag[engine->bag_iterator%NUMSHAPES];
    engine->nextshape = engine->bag[(engine->bag_iterator+1)%NUMSHAPES];
    engine->bag_iterator++;
+   engine->orientation = FIRSTORIENTATION[engine->curshape];
    engine->score = 0;
    engine->status.moves = engine->status.rotations = engine->status.dropcount = engine->status.efficiency = engine->status.droppedlines = 0;
    /* initialize shapes */
@@ -326,6 +516,8 @@ void engine_init (engine_t *engine,void (*score_function)(engine_t *))
    memset (engine->board,0,sizeof (board_t));
    for (i = 0; i < NUMCOLS; i++) engine->board[i][NUMROWS - 1] = engine->board[i][NUMROWS - 2] = WALL;
    for (i = 0; i < NUMROWS; i++) engine->board[0][i] = engine->board[NUMCOLS - 1][i] = engine->board[NUMCOLS - 2][i] = WALL;
+   engine->hash = engine_hash (engine);
+   find_surface (engine);
 }
 
 /*
@@ -333,6 +525,7 @@ void engine_init (engine_t *engine,void (*score_function)(engine_t *))
  */
 void engine_move (engine_t *engine,action_t action)
 {
+   PROFILE_ZONE (ZONE_ENGINE_MOVE);
    switch (action)
 	 {
 		/* move shape to the left if possible */
@@ -359,6 +552,61 @@ void engine_move (engine_t *engine,action_t action)
 	  case ACTION_DROP:
 		engine->status.dropcount += shape_drop (engine);
 	 }
+   CHECK_HASH (engine);
+}
+
+/*
+ * Compute the hash of the engine from scratch. The current shape must
+ * be on the board or in a place it fits, which it isn't once the game
+ * is over
+ */
+uint64_t engine_hash (const engine_t *engine)
+{
+   shape_t shape = engine->shapes[engine->curshape];
+   board_t board;
+   uint64_t hash;
+   int x,y;
+   /* Only the blocks that have come to rest */
+   memcpy (board,engine->board,sizeof (board_t));
+   eraseshape (board,&shape,engine->curx,engine->cury);
+   if (engine->shadow) eraseshape (board,&shape,engine->curx_shadow,engine->cury_shadow);
+   hash = ZPIECE (engine->orientation,engine->curx,engine->cury) ^ ZNEXT (engine->nextshape) ^ ZBAG (bagmask (engine));
+   for (x = 1; x < NUMCOLS - 2; x++) for (y = 0; y < NUMROWS - 2; y++)
+	 if (board[x][y]) hash ^= ZCELL (x,y);
+   return (hash);
+}
+
+/*
+ * Index in ORIENTATIONS of the way shape is turned now
+ */
+int engine_orientation (const shape_t *shape)
+{
+   int i;
+   for (i = FIRSTORIENTATION[shape->type]; i < FIRSTORIENTATION[shape->type + 1]; i++)
+	 if (memcmp (ORIENTATIONS[i].block,shape->block,sizeof (shape->block)) == 0) return (i);
+   return (FIRSTORIENTATION[shape->type]);
+}
+
+/*
+ * Turn the current shape like engine->orientation and work out the
+ * hash and the surface from the board
+ */
+void engine_rebuild (engine_t *engine)
+{
+   shape_t *shape = &engine->shapes[engine->curshape];
+   int first = FIRSTORIENTATION[engine->curshape],last = FIRSTORIENTATION[engine->curshape + 1];
+   memcpy (engine->shapes,SHAPES,sizeof (shapes_t));
+   memcpy (shape->block,ORIENTATIONS[engine->orientation].block,sizeof (shape->block));
+   shape->orientation = engine->orientation;
+   /* Shapes that turn back and forth between two orientations are flipped in the second */
+   shape->flipped = last - first == 2 && engine->orientation != first;
+   /* The surface is made of the blocks at rest, so lift the shape and its shadow off the board */
+   eraseshape (engine->board,shape,engine->curx,engine->cury);
+   if (engine->shadow) eraseshape (engine->board,shape,engine->curx_shadow,engine->cury_shadow);
+   find_surface (engine);
+   if (engine->shadow) drawshape (engine->board,shape,engine->curx_shadow,engine->cury_shadow);
+   drawshape (engine->board,shape,engine->curx,engine->cury);
+   engine->hash = engine_hash (engine);
 }
 
 /*
@@ -371,10 +619,22 @@ void engine_move (engine_t *engine,action_t action)
  */
 int engine_evaluate (engine_t *engine)
 {
+   PROFILE_ZONE (ZONE_ENGINE_EVALUATE);
    if (shape_bottom (engine))
 	 {
+		const shape_t *shape = &engine->shapes[engine->curshape];
+		int i,dropped_lines;
+		/* the shape is part of the board now */
+		engine->hash ^= ZPIECE (engine->orientation,engine->curx,engine->cury) ^ ZNEXT (engine->nextshape) ^ ZBAG (bagmask (engine));
+		for (i = 0; i < NUMBLOCKS; i++) engine->hash ^= ZCELL (engine->curx + shape->block[i].x,engine->cury + shape->block[i].y);
+		for (i = 0; i < PROFILES[engine->orientation].width; i++)
+		  {
+			 int x = engine->curx + PROFILES[engine->orientation].left + i,y = engine->cury + PROFILES[engine->orientation].top[i];
+			 if (y < engine->surface[x]) engine->surface[x] = y;
+		  }
 		/* update status information */
-		int dropped_lines = droplines(engine->board);
+		dropped_lines = droplines(engine);
+		if (dropped_lines) find_surface (engine);
 		engine->status.droppedlines += dropped_lines;
 		engine->status.currentdroppedlines = dropped_lines;
 		/* increase score */
@@ -395,14 +655,19 @@ int engine_evaluate (engine_t *engine)
 		engine->cury_shadow = 1;
 		engine->curshape = engine->bag[engine->bag_iterator%NUMSHAPES];
 		/* shuffle bag before first item in bag would be reused */
-		if ((engine->bag_iterator+1) % NUMSHAPES == 0) shuffle(engine->bag, NUMSHAPES);
+		if ((engine->bag_iterator+1) % NUMSHAPES == 0) shuffle(&engine->rng,engine->bag, NUMSHAPES);
 		engine->nextshape = engine->bag[(engine->bag_iterator+1)%NUMSHAPES];
 		engine->bag_iterator++;
 		/* initialize shapes */
 		memcpy (engine->shapes,SHAPES,sizeof (shapes_t));
+		engine->orientation = FIRSTORIENTATION[engine->curshape];
+		engine->hash ^= ZPIECE (engine->orientation,engine->curx,engine->cury) ^ ZNEXT (engine->nextshape) ^ ZBAG (bagmask (engine));
 		/* return games status */
-		return allowed (engine->board,&engine->shapes[engine->curshape],engine->curx,engine->cury) ? 0 : -1;
+		if (!allowed (engine->board,&engine->shapes[engine->curshape],engine->curx,engine->cury)) return -1;
+		CHECK_HASH (engine);
+		return 0;
 	 }
    shape_down (engine);
+   CHECK_HASH (engine);
    return 1;
 }
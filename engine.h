@@ -29,6 +29,8 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdint.h>			/* uint64_t */
+
 #include "typedefs.h"		/* bool */
 
 /*
@@ -45,6 +47,9 @@
 #define NUMROWS	23
 #define NUMCOLS	13
 
+/* Number of different orientations of all the shapes together */
+#define NUMORIENTATIONS 19
+
 /* Wall id - Arbitrary, but shouldn't have the same value as one of the colors */
 #define WALL 16
 
@@ -65,8 +70,26 @@ typedef struct
    int type;
    bool flipped;
    block_t block[NUMBLOCKS];
+   int orientation;				/* index in ORIENTATIONS */
 } shape_t,shapes_t[NUMSHAPES];
 
+/* A shape after some clockwise rotations */
+typedef struct
+{
+   int type;
+   int rotations;
+   block_t block[NUMBLOCKS];
+} orientation_t;
+
+/* The columns of an orientation, from the left */
+typedef struct
+{
+   int left;				/* x offset of the first column */
+   int width;				/* number of columns */
+   int bottom[NUMBLOCKS];	/* y offset of the lowest block in each column */
+   int top[NUMBLOCKS];		/* y offset of the highest block in each column */
+} profile_t;
+
 typedef struct
 {
    int moves;
@@ -89,6 +112,11 @@ typedef struct engine_struct
    board_t board;									/* board */
    status_t status;									/* current status of shapes */
    void (*score_function)(struct engine_struct *);	/* score function */
+   void *data;										/* for the score function */
+   uint64_t rng;									/* random number generator state */
+   int orientation;									/* index of the current shape in ORIENTATIONS */
+   uint64_t hash;									/* Zobrist hash of the position */
+   int surface[NUMCOLS];							/* highest row with a block at rest in each column */
 } engine_t;
 
 typedef enum { ACTION_LEFT, ACTION_ROTATE_CLOCKWISE, ACTION_ROTATE_COUNTERCLOCKWISE, ACTION_RIGHT, ACTION_DROP, ACTION_DOWN } action_t;
@@ -99,20 +127,56 @@ typedef enum { ACTION_LEFT, ACTION_ROTATE_CLOCKWISE, ACTION_ROTATE_COUNTERCLOCKW
 
 extern const shapes_t SHAPES;
 
+/*
+ * Every way a shape can be turned. The orientations of shape n are
+ * ORIENTATIONS[FIRSTORIENTATION[n]] up to ORIENTATIONS[FIRSTORIENTATION[n + 1]]
+ */
+extern const orientation_t ORIENTATIONS[NUMORIENTATIONS];
+extern const int FIRSTORIENTATION[NUMSHAPES + 1];
+
+/*
+ * The columns of every orientation. Dropped from above the surface, a
+ * shape lands where the first of its columns meets it, and the surface
+ * grows by the tops of its columns
+ */
+extern const profile_t PROFILES[NUMORIENTATIONS];
+
 /*
  * Functions
  */
 
 /*
- * Initialize specified tetris engine
+ * Initialize specified tetris engine. Engines with the same seed
+ * get the same shapes. data is kept in engine->data for the score
+ * function
  */
-void engine_init (engine_t *engine,void (*score_function)(engine_t *));
+void engine_init (engine_t *engine,unsigned int seed,void (*score_function)(engine_t *),void *data);
 
 /*
  * Perform the given action on the specified tetris engine
  */
 void engine_move (engine_t *engine,action_t action);
 
+/*
+ * The hash of an engine covers the blocks that have come to rest, where
+ * the current shape is and how it's turned, the next shape and what's
+ * left in the bag. engine->hash is kept up to date as the game goes;
+ * this computes it from scratch
+ */
+uint64_t engine_hash (const engine_t *engine);
+
+/*
+ * Index in ORIENTATIONS of the way shape is turned now
+ */
+int engine_orientation (const shape_t *shape);
+
+/*
+ * Bring the rest of the engine in line with the board, the position
+ * and orientation of the current shape, and the bag, after they were
+ * filled in by hand (e.g. from a saved game)
+ */
+void engine_rebuild (engine_t *engine);
+
 /*
  * Evaluate the status of the specified tetris engine
  *
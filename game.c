@@ -0,0 +1,573 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The game itself: what the keys do, scoring and drawing. Nothing in
+ * here is global, so one process can run as many games as it likes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "io.h"
+#include "engine.h"
+#include "game.h"
+#include "telemetry.h"
+#include "history.h"
+#include "profile.h"
+
+/*
+ * Macros
+ */
+
+/* Upper left corner of board */
+#define XTOP ((out_width () - NUMROWS - 3) >> 1)
+#define YTOP ((out_height () - NUMCOLS - 9) >> 1)
+
+/* Maximum digits in a number (i.e. number of digits in score, */
+/* number of blocks, etc. should not exceed this value */
+#define MAXDIGITS 5
+
+/* This calculates the time allowed to move a shape, before it is moved a row down */
+#define DELAY(level) (1000000 / ((level) + 2))
+
+/*
+ * Functions
+ */
+
+/* Number of clockwise quarter turns from the way a shape appeared to the way it is now */
+static int orientation (const shape_t *shape)
+{
+   shape_t test = SHAPES[shape->type];
+   int r,i,tmp;
+   for (r = 0; r < 4; r++)
+	 {
+		if (memcmp (test.block,shape->block,sizeof (test.block)) == 0) return (r);
+		for (i = 0; i < NUMBLOCKS; i++)
+		  {
+			 tmp = test.block[i].x;
+			 test.block[i].x = -test.block[i].y;
+			 test.block[i].y = tmp;
+		  }
+	 }
+   return (0);
+}
+
+/* This function is responsible for increasing the score appropriately whenever
+ * a block collides at the bottom of the screen (or the top of the heap */
+static void score_function (engine_t *engine)
+{
+   game_t *game = engine->data;
+   record_t *record = &game->record;
+   int score = SCOREVAL (game->level * (engine->status.dropcount + 1));
+   score += SCOREVAL ((game->level + 10) * engine->status.currentdroppedlines * engine->status.currentdroppedlines);
+
+   if (game->shownext) score /= 2;
+   if (game->dottedlines) score /= 2;
+
+   /* Most of the telemetry record. The engine updates the efficiency after this */
+   record->game = game->id;
+   record->piece = game_shapes (game);
+   record->type = engine->curshape;
+   record->x = engine->curx;
+   record->y = engine->cury;
+   record->orientation = orientation (&engine->shapes[engine->curshape]);
+   record->status = engine->status;
+   record->score = GETSCORE (engine->score + score) - GETSCORE (engine->score);
+   record->level = game->level;
+   record->think = microseconds () - game->spawned;
+
+   engine->score += score;
+}
+
+/* Draw the board on the screen */
+static void drawboard (const game_t *game)
+{
+   int x,y;
+   PROFILE_ZONE (ZONE_DRAWBOARD);
+   out_setattr (ATTR_OFF);
+   for (y = 1; y < NUMROWS - 1; y++) for (x = 0; x < NUMCOLS - 1; x++)
+	 {
+		out_gotoxy (XTOP + x * 2,YTOP + y);
+		switch (game->engine.board[x][y])
+		  {
+			 /* Wall */
+		   case WALL:
+			 out_setattr (ATTR_BOLD);
+			 out_setcolor (COLOR_BLUE,COLOR_BLACK);
+			 out_putch ('<');
+			 out_putch ('>');
+			 out_setattr (ATTR_OFF);
+			 break;
+			 /* Background */
+		   case 0:
+			 if (game->dottedlines)
+			   {
+				  out_setcolor (COLOR_BLUE,COLOR_BLACK);
+				  out_putch ('.');
+				  out_putch (' ');
+			   }
+			 else
+			   {
+				  out_setcolor (COLOR_BLACK,COLOR_BLACK);
+				  out_putch (' ');
+				  out_putch (' ');
+			   }
+			 break;
+			 /* Block */
+		   default:
+			 out_setcolor (COLOR_BLACK,game->engine.board[x][y]);
+			 out_putch (game->blockchar);
+			 out_putch (game->blockchar);
+		  }
+	 }
+   out_setattr (ATTR_OFF);
+}
+
+/* Outline where the hint says the current shape should go */
+static void drawhint (const game_t *game)
+{
+   const block_t *block = ORIENTATIONS[game->suggestion.orientation].block;
+   int i,x,y;
+   if (!game->hinted) return;
+   out_setattr (ATTR_BOLD);
+   out_setcolor (SHAPES[game->engine.curshape].color,COLOR_BLACK);
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		x = game->suggestion.x + block[i].x;
+		y = game->suggestion.y + block[i].y;
+		/* Blocks (the shape itself, or its shadow) go over the outline */
+		if (game->engine.board[x][y]) continue;
+		out_gotoxy (XTOP + x * 2,YTOP + y);
+		out_putch ('[');
+		out_putch (']');
+	 }
+   out_setattr (ATTR_OFF);
+}
+
+/* Show the next piece on the screen */
+static void drawnext (int shapenum,int x,int y)
+{
+   int i;
+   block_t ofs[NUMSHAPES] =
+	 { { 1,  0 }, { 1,  0 }, { 1, -1 }, { 2,  0 }, { 1, -1 }, { 1, -1 }, { 0, -1 } };
+   out_setcolor (COLOR_BLACK,COLOR_BLACK);
+   for (i = y - 2; i < y + 2; i++)
+	 {
+		out_gotoxy (x - 2,i);
+		out_printf ("        ");
+	 }
+   out_setcolor (COLOR_BLACK,SHAPES[shapenum].color);
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		out_gotoxy (x + SHAPES[shapenum].block[i].x * 2 + ofs[shapenum].x,
+					y + SHAPES[shapenum].block[i].y + ofs[shapenum].y);
+		out_putch (' ');
+		out_putch (' ');
+	 }
+}
+
+/* Draw the background */
+static void drawbackground (const game_t *game)
+{
+   out_setattr (ATTR_OFF);
+   out_setcolor (COLOR_WHITE,COLOR_BLACK);
+   out_gotoxy (4,YTOP + 7);   out_printf ("H E L P");
+   out_gotoxy (1,YTOP + 9);   out_printf ("p: Pause");
+   out_gotoxy (1,YTOP + 10);  out_printf ("j: Left");
+   out_gotoxy (1,YTOP + 11);  out_printf ("l: Right");
+   out_gotoxy (1,YTOP + 12);  out_printf ("K: Rotate (clockwise)");
+   out_gotoxy (1,YTOP + 13);  out_printf ("k: Rotate (counterclockwise)");
+   out_gotoxy (1,YTOP + 14);  out_printf ("s: Draw next");
+   out_gotoxy (1,YTOP + 15);  out_printf ("d: Toggle lines");
+   out_gotoxy (1,YTOP + 16);  out_printf ("a: Speed up");
+   out_gotoxy (1,YTOP + 17);  out_printf ("q: Quit");
+   out_gotoxy (2,YTOP + 18);  out_printf ("SPACE: Drop");
+   if (game->history != NULL) { out_gotoxy (1,YTOP + 19);  out_printf ("u: Take back"); }
+   out_gotoxy (3,YTOP + 20);  out_printf ("Next:");
+}
+
+/* Number of shapes released so far */
+int game_shapes (const game_t *game)
+{
+   int i,sum = 0;
+   for (i = 0; i < NUMSHAPES; i++) sum += game->shapecount[i];
+   return (sum);
+}
+
+/* This show the current status of the game */
+static void showstatus (const game_t *game)
+{
+   const engine_t *engine = &game->engine;
+   static const int shapenum[NUMSHAPES] = { 4, 6, 5, 1, 0, 3, 2 };
+   char tmp[MAXDIGITS + 1];
+   int i,sum = game_shapes (game);
+   PROFILE_ZONE (ZONE_SHOWSTATUS);
+   out_setattr (ATTR_OFF);
+   out_setcolor (COLOR_WHITE,COLOR_BLACK);
+   out_gotoxy (1,YTOP + 1);   out_printf ("Your level: %d",game->level);
+   out_gotoxy (1,YTOP + 2);   out_printf ("Full lines: %d",engine->status.droppedlines);
+   out_gotoxy (2,YTOP + 4);   out_printf ("Score");
+   out_setattr (ATTR_BOLD);
+   out_setcolor (COLOR_YELLOW,COLOR_BLACK);
+   out_printf ("  %d",GETSCORE (engine->score));
+   if (game->shownext) drawnext (engine->nextshape,3,YTOP + 22);
+   out_setattr (ATTR_OFF);
+   out_setcolor (COLOR_WHITE,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 12,YTOP + 1);
+   out_printf ("STATISTICS");
+   out_setcolor (COLOR_BLACK,COLOR_MAGENTA);
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 3);
+   out_printf ("      ");
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 4);
+   out_printf ("  ");
+   out_setcolor (COLOR_MAGENTA,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 3);
+   out_putch ('-');
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[0]]);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 3);
+   out_printf ("%s",tmp);
+   out_setcolor (COLOR_BLACK,COLOR_RED);
+   out_gotoxy (out_width () - MAXDIGITS - 13,YTOP + 5);
+   out_printf ("        ");
+   out_setcolor (COLOR_RED,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 5);
+   out_putch ('-');
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[1]]);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 5);
+   out_printf ("%s",tmp);
+   out_setcolor (COLOR_BLACK,COLOR_WHITE);
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 7);
+   out_printf ("      ");
+   out_gotoxy (out_width () - MAXDIGITS - 13,YTOP + 8);
+   out_printf ("  ");
+   out_setcolor (COLOR_WHITE,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 7);
+   out_putch ('-');
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[2]]);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 7);
+   out_printf ("%s",tmp);
+   out_setcolor (COLOR_BLACK,COLOR_GREEN);
+   out_gotoxy (out_width () - MAXDIGITS - 9,YTOP + 9);
+   out_printf ("    ");
+   out_gotoxy (out_width () - MAXDIGITS - 11,YTOP + 10);
+   out_printf ("    ");
+   out_setcolor (COLOR_GREEN,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 9);
+   out_putch ('-');
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[3]]);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 9);
+   out_printf ("%s",tmp);
+   out_setcolor (COLOR_BLACK,COLOR_CYAN);
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 11);
+   out_printf ("    ");
+   out_gotoxy (out_width () - MAXDIGITS - 15,YTOP + 12);
+   out_printf ("    ");
+   out_setcolor (COLOR_CYAN,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 11);
+   out_putch ('-');
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[4]]);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 11);
+   out_printf ("%s",tmp);
+   out_setcolor (COLOR_BLACK,COLOR_BLUE);
+   out_gotoxy (out_width () - MAXDIGITS - 9,YTOP + 13);
+   out_printf ("    ");
+   out_gotoxy (out_width () - MAXDIGITS - 9,YTOP + 14);
+   out_printf ("    ");
+   out_setcolor (COLOR_BLUE,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 13);
+   out_putch ('-');
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[5]]);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 13);
+   out_printf ("%s",tmp);
+   out_setattr (ATTR_OFF);
+   out_setcolor (COLOR_BLACK,COLOR_YELLOW);
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 15);
+   out_printf ("      ");
+   out_gotoxy (out_width () - MAXDIGITS - 15,YTOP + 16);
+   out_printf ("  ");
+   out_setcolor (COLOR_YELLOW,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 15);
+   out_putch ('-');
+   snprintf (tmp,MAXDIGITS + 1,"%d",game->shapecount[shapenum[6]]);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 15);
+   out_printf ("%s",tmp);
+   out_setcolor (COLOR_WHITE,COLOR_BLACK);
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 17);
+   for (i = 0; i < MAXDIGITS + 16; i++) out_putch ('-');
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 18);
+   out_printf ("Sum          :");
+   snprintf (tmp,MAXDIGITS + 1,"%d",sum);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 18);
+   out_printf ("%s",tmp);
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 20);
+   for (i = 0; i < MAXDIGITS + 16; i++) out_putch (' ');
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 20);
+   out_printf ("Score ratio  :");
+   snprintf (tmp,MAXDIGITS + 1,"%d",GETSCORE (engine->score) / sum);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 20);
+   out_printf ("%s",tmp);
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 21);
+   for (i = 0; i < MAXDIGITS + 16; i++) out_putch (' ');
+   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 21);
+   out_printf ("Efficiency   :");
+   snprintf (tmp,MAXDIGITS + 1,"%d",engine->status.efficiency);
+   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 21);
+   out_printf ("%s",tmp);
+}
+
+static void evaluate (game_t *game)
+{
+	engine_t *engine = &game->engine;
+	int result;
+	if (game->history != NULL) history_prepare (game->history,game);
+	result = engine_evaluate (engine);
+	if (result <= 0)
+	{
+		game->record.status.efficiency = engine->status.efficiency;
+		telemetry_record (&game->record);
+		game->spawned = microseconds ();
+	}
+	switch (result)
+	{
+		/* game over (board full) */
+		case -1:
+			if ((game->level < MAXLEVEL) && ((engine->status.droppedlines / 10) > game->level)) game->level++;
+			game->finished = TRUE;
+			break;
+			/* shape at bottom, next one released */
+		case 0:
+			if ((game->level < MAXLEVEL) && ((engine->status.droppedlines / 10) > game->level))
+			{
+				game->level++;
+				game->gravity = DELAY (game->level);
+			}
+			game->shapecount[engine->curshape]++;
+			if (game->history != NULL) history_landed (game->history,game);
+			break;
+			/* shape moved down one line */
+		case 1:
+			break;
+	}
+}
+
+/* Initialize a game with the default options */
+void game_init (game_t *game,unsigned int seed)
+{
+   memset (game,0,sizeof (game_t));
+   game->level = MINLEVEL - 1;
+   game->blockchar = ' ';
+   game_reseed (game,seed);
+}
+
+/* Start over with the shapes another seed picks */
+void game_reseed (game_t *game,unsigned int seed)
+{
+   engine_init (&game->engine,seed,score_function,game);
+   memset (game->shapecount,0,sizeof (game->shapecount));
+   game->shapecount[game->engine.curshape]++;
+   game->seed = seed;
+}
+
+/* Draw the background and start the clock */
+void game_start (game_t *game)
+{
+   ansi_use (game->renderer);
+   game->engine.shadow = game->shadow;
+   drawbackground (game);
+   game->gravity = DELAY (game->level);
+   /* The clock of the io backend ticks with the game */
+   in_timeout (TICK);
+   game->spawned = microseconds ();
+}
+
+/* Draw the board and status, then refresh the screen */
+void game_draw (game_t *game)
+{
+   ansi_use (game->renderer);
+   showstatus (game);
+   drawboard (game);
+   if (game->hint != NULL)
+	 {
+		/* Ask once for every shape, then show the latest answer */
+		if (game->asked != game_shapes (game))
+		  {
+			 game->asked = game_shapes (game);
+			 hint_ask (game->hint,&game->engine,game->asked,DELAY (game->level) / 4);
+		  }
+		game->hinted = hint_answer (game->hint,game->asked,&game->suggestion);
+		drawhint (game);
+	 }
+   out_refresh ();
+}
+
+/* Handle a key pressed by the player */
+void game_key (game_t *game,int ch)
+{
+   engine_t *engine = &game->engine;
+   ansi_use (game->renderer);
+   /* Any key continues a paused game */
+   if (game->paused)
+	 {
+		game->paused = FALSE;
+		/* Time spent paused isn't time spent thinking */
+		game->spawned += microseconds () - game->pausedat;
+		out_gotoxy ((out_width () - 34) / 2,out_height () - 2);
+		out_printf ("                                  ");
+		in_flush ();							/* Clear keyboard buffer */
+		return;
+	 }
+   switch (ch)
+	 {
+	  case 'j':
+	  case KEY_LEFT:
+		engine_move (engine,ACTION_LEFT);
+		break;
+	  case 'k':
+	  case KEY_UP:
+	  case '\n':
+		engine_move (engine,ACTION_ROTATE_COUNTERCLOCKWISE);
+		break;
+	  case 'K':
+		engine_move (engine,ACTION_ROTATE_CLOCKWISE);
+		break;
+	  case 'l':
+	  case KEY_RIGHT:
+		engine_move (engine,ACTION_RIGHT);
+		break;
+	  case KEY_DOWN:
+		engine_move (engine,ACTION_DOWN);
+		break;
+	  case ' ':
+		engine_move (engine,ACTION_DROP);
+		evaluate (game);          /* prevent key press after drop */
+		break;
+		/* show next piece */
+	  case 's':
+		game->shownext = TRUE;
+		break;
+		/* toggle dotted lines */
+	  case 'd':
+		game->dottedlines = !game->dottedlines;
+		break;
+		/* next level */
+	  case 'a':
+		if (game->level < MAXLEVEL)
+		  {
+			 game->level++;
+			 game->gravity = DELAY (game->level);
+		  }
+		else out_beep ();
+		break;
+		/* quit */
+	  case 'q':
+		game->finished = game->quit = TRUE;
+		break;
+		/* quit, but keep the game to carry on with later */
+	  case 'S':
+		game->finished = game->quit = game->suspended = TRUE;
+		break;
+		/* take back the last shape in a practice game */
+	  case 'u':
+		if (game->history != NULL && history_rewind (game->history,game,1))
+		  {
+			 game->gravity = DELAY (game->level);
+			 game->spawned = microseconds ();
+		  }
+		else out_beep ();
+		break;
+		/* pause until the next key */
+	  case 'p':
+		out_setcolor (COLOR_WHITE,COLOR_BLACK);
+		out_gotoxy ((out_width () - 34) / 2,out_height () - 2);
+		out_printf ("Paused - Press any key to continue");
+		game->paused = TRUE;
+		game->pausedat = microseconds ();
+		break;
+		/* unknown keypress */
+	  default:
+		out_beep ();
+	 }
+   in_flush ();
+}
+
+/* Move the shape down a line because the player took too long */
+void game_tick (game_t *game)
+{
+   ansi_use (game->renderer);
+   if (game->paused) return;
+   if (game->ai != NULL && game->planned == game_shapes (game))
+	 engine_move (&game->engine,ACTION_DROP);
+   evaluate (game);
+}
+
+/* Play one tick */
+bool game_step (game_t *game)
+{
+   bool moved = FALSE;
+   /* What's left of a tick goes to the next row, so the shape falls as fast as DELAY () says on average */
+   if (!game->paused && !game->finished && (game->gravity -= TICK) <= 0)
+	 {
+		game->gravity += DELAY (game->level);
+		game_tick (game);
+		moved = TRUE;
+	 }
+   game->tick++;
+   return (moved);
+}
+
+/* Ticks until the shape moves down by itself */
+int game_due (const game_t *game)
+{
+   return ((game->gravity + TICK - 1) / TICK);
+}
+
+/* Let the AI move a new shape into place */
+bool game_think (game_t *game)
+{
+   engine_t *engine = &game->engine;
+   ai_move_t move;
+   int i;
+   if (game->ai == NULL || game->paused || game->finished || game->planned == game_shapes (game)) return (FALSE);
+   /* Answer well before the shape moves down, unless told how far to look */
+   if (game->lookahead ? !ai_choose (game->ai,engine,0,game->lookahead,&move) :
+	   game->rollout != NULL ? !rollout_choose (game->rollout,engine,DELAY (game->level) / 2,&move) :
+	   !ai_choose (game->ai,engine,DELAY (game->level) / 2,AI_MAXDEPTH,&move)) return (FALSE);
+   /* Only a move that was found counts as a plan, so a failed search is tried again */
+   game->planned = game_shapes (game);
+   ansi_use (game->renderer);
+   for (i = 0; i < move.rotations; i++) engine_move (engine,ACTION_ROTATE_CLOCKWISE);
+   if (move.rotations < 0) engine_move (engine,ACTION_ROTATE_COUNTERCLOCKWISE);
+   for (i = engine->curx; i > move.x; i--) engine_move (engine,ACTION_LEFT);
+   for (i = engine->curx; i < move.x; i++) engine_move (engine,ACTION_RIGHT);
+   return (TRUE);
+}
+
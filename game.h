@@ -0,0 +1,165 @@
+#ifndef GAME_H
+#define GAME_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t, NUMSHAPES */
+#include "io.h"				/* ansi_t */
+#include "telemetry.h"		/* record_t */
+#include "ai.h"				/* ai_t */
+#include "rollout.h"			/* rollout_t */
+#include "hint.h"				/* hint_t */
+
+/*
+ * Macros
+ */
+
+/* Number of levels in the game */
+#define MINLEVEL	1
+#define MAXLEVEL	9
+
+/* The score is multiplied by this to avoid losing precision */
+#define SCOREFACTOR 2
+
+/* This calculates the stored score value */
+#define SCOREVAL(x) (SCOREFACTOR * (x))
+
+/* This calculates the real (displayed) value of the score */
+#define GETSCORE(score) ((score) / SCOREFACTOR)
+
+/* Length of a tick in microseconds. The game moves on a whole tick at a time */
+#define TICK 10000
+
+/*
+ * Type definitions
+ */
+
+/*
+ * Everything about one game. Nothing else is shared between games, so any
+ * number of them can be played at once, in as many threads as you like.
+ */
+typedef struct
+{
+   engine_t engine;
+   unsigned int seed;			/* picks the shapes */
+   unsigned long tick;			/* ticks played so far */
+   int gravity;					/* microseconds left before the shape moves down */
+   ansi_t *renderer;			/* drawn with, NULL for the selected io backend */
+   int level;					/* current level */
+   int shapecount[NUMSHAPES];	/* number of shapes of each kind released */
+   bool shownext;				/* draw next shape */
+   bool dottedlines;			/* draw vertical dotted lines */
+   bool shadow;					/* draw shadow of shape */
+   char blockchar;				/* character used to draw blocks */
+   bool paused;					/* waiting for a key to continue */
+   bool finished;				/* game over, or the player quit */
+   bool quit;					/* the player quit */
+   bool suspended;				/* the player quit to carry on later */
+   unsigned int id;				/* game number in telemetry records */
+   long long spawned;			/* when the current shape appeared, in microseconds */
+   long long pausedat;			/* when the game was paused */
+   record_t record;				/* the shape that just landed */
+   ai_t *ai;					/* plays the game, NULL if a person does */
+   rollout_t *rollout;			/* if set, the AI chooses by playing on from every placement */
+   int planned;					/* last shape the AI moved into place */
+   int lookahead;				/* shapes the AI looks ahead, 0 for as many as there's time for */
+   hint_t *hint;				/* shows the player where the AI would put shapes, if set */
+   struct history_struct *history;	/* lets the player take back shapes, if set */
+   int asked;					/* last shape a hint was asked for */
+   bool hinted;					/* there's a hint for the current shape */
+   ai_move_t suggestion;		/* the hint */
+} game_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Initialize a game with the default options. The seed picks the
+ * shapes. The level is left below MINLEVEL, so the caller can tell
+ * whether one was chosen.
+ */
+void game_init (game_t *game,unsigned int seed);
+
+/*
+ * Start over with the shapes another seed picks, keeping the options
+ */
+void game_reseed (game_t *game,unsigned int seed);
+
+/*
+ * Draw the background and start the clock. Must be called after
+ * io_init () and after the options have been set.
+ */
+void game_start (game_t *game);
+
+/*
+ * Draw the board and status, then refresh the screen
+ */
+void game_draw (game_t *game);
+
+/*
+ * Handle a key pressed by the player
+ */
+void game_key (game_t *game,int ch);
+
+/*
+ * Move the shape down a line because the player took too long, or
+ * drop it if the AI has put it where it wants it
+ */
+void game_tick (game_t *game);
+
+/*
+ * Play one tick. The shape moves down every few ticks, depending on the
+ * level. Nothing but the keys handled and the ticks played decides how
+ * the game goes, so the same keys in the same ticks play the same game
+ * with the same seed, however fast the ticks come. Returns TRUE if the
+ * shape moved
+ */
+bool game_step (game_t *game);
+
+/*
+ * Number of ticks until the shape moves down by itself, if the game
+ * isn't paused and no key changes the level before then
+ */
+int game_due (const game_t *game);
+
+/*
+ * If an AI plays the game, move a new shape to where it wants it. The
+ * shape drops the next time it would move down. Returns TRUE if the
+ * shape was moved
+ */
+bool game_think (game_t *game);
+
+/*
+ * Number of shapes released so far
+ */
+int game_shapes (const game_t *game);
+
+#endif	/* #ifndef GAME_H */
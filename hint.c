@@ -0,0 +1,219 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Hints for the player, worked out on a thread of their own. Questions
+ * (a copy of the engine) and answers (a placement) go through mailboxes
+ * that hold a single letter and never block: a letter nobody picked up
+ * yet is simply replaced by the next one. Each answer says which shape
+ * it is for, so an answer for a shape that has landed in the meantime
+ * is ignored. A quick answer is posted first, and a better one after it
+ * if no new question came in.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "ai.h"
+#include "hint.h"
+
+/*
+ * Macros
+ */
+
+/* Set in mailbox_t.middle while the letter there wasn't picked up */
+#define FRESH 4
+
+/*
+ * Type definitions
+ */
+
+/* A question or an answer */
+typedef struct
+{
+   int shape;					/* shape number in the game */
+   long budget;
+   engine_t engine;
+   bool found;
+   ai_move_t move;
+} letter_t;
+
+/*
+ * A single-slot mailbox for one writer and one reader. There are three
+ * letters: the one being written, the one being read, and the one in
+ * between. Posting swaps the one written with the one in between, and
+ * picking up swaps the one in between with the one read, so neither side
+ * ever waits for the other
+ */
+typedef struct
+{
+   letter_t letter[3];
+   int writing,reading;			/* owned by the writer and the reader */
+   int middle;					/* the one in between, | FRESH if it's new */
+} mailbox_t;
+
+struct hint_struct
+{
+   mailbox_t questions,answers;
+   sem_t asked;					/* posted with every question */
+   pthread_t thread;
+   ai_t *ai;
+   bool quit;
+};
+
+/*
+ * Mailboxes
+ */
+
+static void mailbox_init (mailbox_t *mailbox)
+{
+   mailbox->writing = 0;
+   mailbox->middle = 1;
+   mailbox->reading = 2;
+   mailbox->letter[mailbox->reading].shape = -1;
+}
+
+/* The letter to write */
+static letter_t *mailbox_draft (mailbox_t *mailbox)
+{
+   return (&mailbox->letter[mailbox->writing]);
+}
+
+/* Post the letter written */
+static void mailbox_post (mailbox_t *mailbox)
+{
+   mailbox->writing = __atomic_exchange_n (&mailbox->middle,mailbox->writing | FRESH,__ATOMIC_ACQ_REL) & ~FRESH;
+}
+
+/* Check if there's a letter to pick up */
+static bool mailbox_pending (const mailbox_t *mailbox)
+{
+   return (__atomic_load_n (&mailbox->middle,__ATOMIC_ACQUIRE) & FRESH);
+}
+
+/* Pick up the latest letter. If there isn't a new one, it's the one picked up before */
+static const letter_t *mailbox_collect (mailbox_t *mailbox)
+{
+   if (mailbox_pending (mailbox))
+	 mailbox->reading = __atomic_exchange_n (&mailbox->middle,mailbox->reading,__ATOMIC_ACQ_REL) & ~FRESH;
+   return (&mailbox->letter[mailbox->reading]);
+}
+
+/*
+ * Thinking
+ */
+
+static void answer (hint_t *hint,const letter_t *question,long budget,int maxdepth)
+{
+   letter_t *letter = mailbox_draft (&hint->answers);
+   letter->shape = question->shape;
+   letter->found = ai_choose (hint->ai,&question->engine,budget,maxdepth,&letter->move);
+   mailbox_post (&hint->answers);
+}
+
+static void *work (void *arg)
+{
+   hint_t *hint = arg;
+   const letter_t *question;
+   int answered = -1;
+   for (;;)
+	 {
+		if (sem_wait (&hint->asked) && errno == EINTR) continue;
+		if (__atomic_load_n (&hint->quit,__ATOMIC_ACQUIRE)) break;
+		question = mailbox_collect (&hint->questions);
+		if (question->shape == answered) continue;
+		answered = question->shape;
+		/* Something to show straight away, then something better */
+		answer (hint,question,0,1);
+		if (!mailbox_pending (&hint->questions)) answer (hint,question,question->budget,AI_MAXDEPTH);
+	 }
+   return (NULL);
+}
+
+/*
+ * Functions
+ */
+
+/* Start a thread that looks for the best placement of shapes */
+hint_t *hint_new ()
+{
+   hint_t *hint;
+   if ((hint = calloc (1,sizeof (hint_t))) == NULL) return (NULL);
+   if ((hint->ai = ai_new (&AI_WEIGHTS)) == NULL)
+	 {
+		free (hint);
+		return (NULL);
+	 }
+   mailbox_init (&hint->questions);
+   mailbox_init (&hint->answers);
+   sem_init (&hint->asked,0,0);
+   if (pthread_create (&hint->thread,NULL,work,hint) != 0)
+	 {
+		sem_destroy (&hint->asked);
+		ai_free (hint->ai);
+		free (hint);
+		return (NULL);
+	 }
+   return (hint);
+}
+
+/* Stop the thread and free everything */
+void hint_free (hint_t *hint)
+{
+   __atomic_store_n (&hint->quit,TRUE,__ATOMIC_RELEASE);
+   sem_post (&hint->asked);
+   pthread_join (hint->thread,NULL);
+   sem_destroy (&hint->asked);
+   ai_free (hint->ai);
+   free (hint);
+}
+
+/* Ask for the best placement of the current shape */
+void hint_ask (hint_t *hint,const engine_t *engine,int shape,long budget)
+{
+   letter_t *letter = mailbox_draft (&hint->questions);
+   letter->shape = shape;
+   letter->budget = budget;
+   letter->engine = *engine;
+   mailbox_post (&hint->questions);
+   sem_post (&hint->asked);
+}
+
+/* Get the latest answer for a shape */
+bool hint_answer (hint_t *hint,int shape,ai_move_t *move)
+{
+   const letter_t *letter = mailbox_collect (&hint->answers);
+   if (letter->shape != shape || !letter->found) return (FALSE);
+   *move = letter->move;
+   return (TRUE);
+}
@@ -0,0 +1,70 @@
+#ifndef HINT_H
+#define HINT_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t */
+#include "ai.h"				/* ai_move_t */
+
+/*
+ * Type definitions
+ */
+
+typedef struct hint_struct hint_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Start a thread that looks for the best placement of shapes. Returns
+ * NULL if something fails
+ */
+hint_t *hint_new ();
+
+/*
+ * Stop the thread and free everything
+ */
+void hint_free (hint_t *hint);
+
+/*
+ * Ask for the best placement of the current shape of engine, which is
+ * shape number shape of the game, taking about budget microseconds.
+ * Never blocks. A question that wasn't answered yet is dropped
+ */
+void hint_ask (hint_t *hint,const engine_t *engine,int shape,long budget);
+
+/*
+ * Get the latest answer for shape number shape. Never blocks. Returns
+ * FALSE if there isn't one yet, or if the shape can't be placed
+ */
+bool hint_answer (hint_t *hint,int shape,ai_move_t *move);
+
+#endif	/* #ifndef HINT_H */
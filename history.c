@@ -0,0 +1,359 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Taking back shapes. Every shape that lands leaves a small delta in a
+ * ring buffer: where it landed, the rows it cleared, and whatever the
+ * next shape can't tell us about the one before (the score, the level
+ * and, when the bag was shuffled, the old bag and the RNG). A delta
+ * starts and ends with its length, so the ring can be walked both ways.
+ * Every so often the whole game is kept as well, as a snapshot, so
+ * going back a long way only needs the deltas after the nearest one.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "game.h"
+#include "snapshot.h"
+#include "history.h"
+
+/*
+ * Macros
+ */
+
+/* Bytes kept for deltas. Must be a power of two */
+#define HISTORYSIZE 65536
+
+/* Shapes between snapshots, and the number of snapshots kept */
+#define KEYINTERVAL 64
+#define KEYFRAMES 128
+
+/* Columns and rows of the board inside the walls */
+#define PLAYCOLS (NUMCOLS - 3)
+#define PLAYROWS (NUMROWS - 2)
+
+/* Bytes of a row of blocks, packed two to a byte */
+#define ROWSIZE ((PLAYCOLS + 1) / 2)
+
+/* Bits in the first byte of a delta */
+#define D_CLEARED	15		/* rows cleared, from the one above the shape down */
+#define D_SHUFFLED	16		/* the old bag and RNG follow */
+#define D_TOPROW	32		/* the top row, which is lost whenever a shape lands, follows */
+
+/* Where a shape appears */
+#define SPAWNX 5
+#define SPAWNY 1
+
+/* Byte i of the ring */
+#define RING(history,i) (history)->ring[(i) & (HISTORYSIZE - 1)]
+
+/*
+ * Type definitions
+ */
+
+/* A snapshot of the game after index shapes landed */
+typedef struct
+{
+   int index;
+   uint32_t head;							/* end of the deltas at the time */
+   unsigned char snapshot[SNAPSHOTSIZE];
+} keyframe_t;
+
+/* What a shape that lands now would leave behind */
+typedef struct
+{
+   int orientation,x,y;
+   int cleared;								/* D_CLEARED bits */
+   bool toprow;								/* there are blocks in the top row */
+   unsigned char rows[NUMBLOCKS + 1][ROWSIZE];	/* rows of the shape, then the top row */
+   int level,score,efficiency,currentdroppedlines;
+   int bag_iterator;
+   int bag[NUMSHAPES];
+   uint64_t rng;
+} pending_t;
+
+struct history_struct
+{
+   unsigned char ring[HISTORYSIZE];
+   uint32_t head,tail;						/* deltas are between tail and head */
+   int top;									/* shapes landed */
+   int bottom;								/* shapes landed when the oldest delta we have was made */
+   pending_t pending;
+   keyframe_t keyframes[KEYFRAMES];
+};
+
+/*
+ * Encoding
+ */
+
+static void packrow (unsigned char *row,const engine_t *engine,int y)
+{
+   int x;
+   memset (row,0,ROWSIZE);
+   for (x = 0; x < PLAYCOLS; x++) row[x / 2] |= engine->board[1 + x][y] << (x & 1) * 4;
+}
+
+static void unpackrow (engine_t *engine,int y,const unsigned char *row)
+{
+   int x;
+   for (x = 0; x < PLAYCOLS; x++) engine->board[1 + x][y] = row[x / 2] >> (x & 1) * 4 & 15;
+}
+
+static void put (history_t *history,int value)
+{
+   RING (history,history->head++) = value;
+}
+
+/* Numbers that are usually small are stored 7 bits at a time, with the sign in the lowest bit */
+static void putnumber (history_t *history,int value)
+{
+   uint32_t n = (uint32_t) value << 1 ^ (uint32_t) (value >> 31);
+   for ( ; n >= 128; n >>= 7) put (history,n | 128);
+   put (history,n);
+}
+
+static int get (const history_t *history,uint32_t *pos)
+{
+   return (RING (history,(*pos)++));
+}
+
+static int getnumber (const history_t *history,uint32_t *pos)
+{
+   uint32_t n = 0,byte;
+   int shift = 0;
+   do
+	 {
+		byte = get (history,pos);
+		n |= (byte & 127) << shift;
+		shift += 7;
+	 }
+   while (byte & 128);
+   return ((int) (n >> 1) ^ -(int) (n & 1));
+}
+
+/*
+ * Recording
+ */
+
+/* Create an empty history */
+history_t *history_new ()
+{
+   return (calloc (1,sizeof (history_t)));
+}
+
+/* Free a history */
+void history_free (history_t *history)
+{
+   free (history);
+}
+
+/* Remember what the shape would leave behind if it landed now */
+void history_prepare (history_t *history,const game_t *game)
+{
+   const engine_t *engine = &game->engine;
+   pending_t *pending = &history->pending;
+   int i,x,y;
+   pending->orientation = engine->orientation;
+   pending->x = engine->curx;
+   pending->y = engine->cury;
+   /* The shape is on the board, so its rows are the ones that fill up */
+   pending->cleared = 0;
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		y = engine->cury - 1 + i;
+		if (y < 1 || y >= PLAYROWS) continue;
+		for (x = 1; x <= PLAYCOLS && engine->board[x][y]; x++) ;
+		if (x > PLAYCOLS)
+		  {
+			 pending->cleared |= 1 << i;
+			 packrow (pending->rows[i],engine,y);
+		  }
+	 }
+   for (x = 1; x <= PLAYCOLS && !engine->board[x][0]; x++) ;
+   if ((pending->toprow = x <= PLAYCOLS)) packrow (pending->rows[NUMBLOCKS],engine,0);
+   pending->level = game->level;
+   pending->score = engine->score;
+   pending->efficiency = engine->status.efficiency;
+   pending->currentdroppedlines = engine->status.currentdroppedlines;
+   pending->bag_iterator = engine->bag_iterator;
+   memcpy (pending->bag,engine->bag,sizeof (pending->bag));
+   pending->rng = engine->rng;
+}
+
+/* Keep the delta of the shape that just landed */
+void history_landed (history_t *history,const game_t *game)
+{
+   const pending_t *pending = &history->pending;
+   bool shuffled = (pending->bag_iterator + 1) % NUMSHAPES == 0;
+   keyframe_t *keyframe;
+   uint32_t start;
+   int i,len;
+   /* Make room for the longest delta there can be */
+   while (HISTORYSIZE - (history->head - history->tail) < 64)
+	 {
+		history->tail += RING (history,history->tail);
+		history->bottom++;
+	 }
+   start = history->head++;
+   put (history,pending->cleared | (shuffled ? D_SHUFFLED : 0) | (pending->toprow ? D_TOPROW : 0));
+   put (history,pending->orientation);
+   put (history,pending->x);
+   put (history,pending->y);
+   put (history,pending->level | pending->currentdroppedlines << 4);
+   putnumber (history,game->engine.score - pending->score);
+   putnumber (history,pending->efficiency);
+   if (shuffled)
+	 {
+		for (i = 0; i < NUMSHAPES; i++) put (history,pending->bag[i]);
+		for (i = 0; i < 64; i += 8) put (history,pending->rng >> i);
+	 }
+   for (i = 0; i <= NUMBLOCKS; i++)
+	 if (i < NUMBLOCKS ? pending->cleared & 1 << i : pending->toprow)
+	   for (len = 0; len < ROWSIZE; len++) put (history,pending->rows[i][len]);
+   len = history->head - start + 1;
+   RING (history,start) = len;
+   put (history,len);
+   /* Every so often, the whole game */
+   if (++history->top % KEYINTERVAL == 0)
+	 {
+		keyframe = &history->keyframes[history->top / KEYINTERVAL % KEYFRAMES];
+		keyframe->index = history->top;
+		keyframe->head = history->head;
+		snapshot_encode (game,keyframe->snapshot);
+	 }
+}
+
+/*
+ * Rewinding
+ */
+
+/* Take the shape that is falling (and its shadow) off the board */
+static void lift (engine_t *engine)
+{
+   const shape_t *shape = &engine->shapes[engine->curshape];
+   int i;
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		engine->board[engine->curx + shape->block[i].x][engine->cury + shape->block[i].y] = COLOR_BLACK;
+		if (engine->shadow) engine->board[engine->curx_shadow + shape->block[i].x][engine->cury_shadow + shape->block[i].y] = COLOR_BLACK;
+	 }
+}
+
+/* Undo the last delta. The shape that appeared after it isn't on the board */
+static void undo (history_t *history,game_t *game)
+{
+   engine_t *engine = &game->engine;
+   const orientation_t *orientation;
+   unsigned char rows[NUMBLOCKS + 1][ROWSIZE];
+   uint32_t pos = history->head - RING (history,history->head - 1) + 1;
+   int flags,shapex,shapey,x,y,i,below = 0;
+   history->head = pos - 1;
+   history->top--;
+   flags = get (history,&pos);
+   orientation = &ORIENTATIONS[get (history,&pos)];
+   shapex = get (history,&pos);
+   shapey = get (history,&pos);
+   i = get (history,&pos);
+   game->level = i & 15;
+   engine->status.currentdroppedlines = i >> 4;
+   engine->score -= getnumber (history,&pos);
+   engine->status.efficiency = getnumber (history,&pos);
+   if (flags & D_SHUFFLED)
+	 {
+		for (i = 0; i < NUMSHAPES; i++) engine->bag[i] = get (history,&pos);
+		for (engine->rng = 0, i = 0; i < 64; i += 8) engine->rng |= (uint64_t) get (history,&pos) << i;
+	 }
+   for (i = 0; i <= NUMBLOCKS; i++)
+	 if (i < NUMBLOCKS ? flags & 1 << i : flags & D_TOPROW)
+	   {
+		  for (x = 0; x < ROWSIZE; x++) rows[i][x] = get (history,&pos);
+		  if (i < NUMBLOCKS) below++;
+	   }
+   engine->status.droppedlines -= below;
+   /* Put the cleared rows back. Every other row comes from as many rows */
+   /* further down as there are cleared rows below it */
+   for (y = 0; y < PLAYROWS; y++)
+	 {
+		i = y - shapey + 1;
+		if (i >= 0 && i < NUMBLOCKS && flags & 1 << i)
+		  {
+			 unpackrow (engine,y,rows[i]);
+			 below--;
+		  }
+		else if (y == 0)
+		  {
+			 if (flags & D_TOPROW) unpackrow (engine,0,rows[NUMBLOCKS]);
+		  }
+		else if (below)
+		  for (x = 1; x <= PLAYCOLS; x++) engine->board[x][y] = engine->board[x][y + below];
+	 }
+   /* Take the shape off again */
+   for (i = 0; i < NUMBLOCKS; i++) engine->board[shapex + orientation->block[i].x][shapey + orientation->block[i].y] = COLOR_BLACK;
+   /* And go back to the shapes there were when it appeared */
+   game->shapecount[engine->curshape]--;
+   engine->nextshape = engine->curshape;
+   engine->curshape = orientation->type;
+   engine->bag_iterator--;
+}
+
+/* Take back the last pieces shapes that landed */
+int history_rewind (history_t *history,game_t *game,int pieces)
+{
+   engine_t *engine = &game->engine;
+   const keyframe_t *keyframe;
+   int target,nearest;
+   if (pieces > history->top - history->bottom) pieces = history->top - history->bottom;
+   if (pieces <= 0) return (0);
+   target = history->top - pieces;
+   /* Start from the first snapshot after where we're going, if we have it */
+   nearest = (target + KEYINTERVAL - 1) / KEYINTERVAL * KEYINTERVAL;
+   keyframe = &history->keyframes[nearest / KEYINTERVAL % KEYFRAMES];
+   if (nearest < history->top && keyframe->index == nearest && snapshot_decode (game,keyframe->snapshot))
+	 {
+		history->top = nearest;
+		history->head = keyframe->head;
+	 }
+   lift (engine);
+   while (history->top > target) undo (history,game);
+   /* The shape is back at the top, still to be moved */
+   engine->curx = engine->curx_shadow = SPAWNX;
+   engine->cury = engine->cury_shadow = SPAWNY;
+   engine->orientation = FIRSTORIENTATION[engine->curshape];
+   engine->status.moves = engine->status.rotations = engine->status.dropcount = 0;
+   engine_rebuild (engine);
+   game->finished = FALSE;
+   /* Shapes we've seen before are new again, to the AI and the hints */
+   game->planned = game->asked = 0;
+   return (pieces);
+}
@@ -0,0 +1,74 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "game.h"			/* game_t */
+
+/*
+ * Type definitions
+ */
+
+typedef struct history_struct history_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Create an empty history. Returns NULL if we run out of memory
+ */
+history_t *history_new ();
+
+/*
+ * Free a history
+ */
+void history_free (history_t *history);
+
+/*
+ * Remember what the shape of game would leave behind if it landed
+ * now. Call this before every engine_evaluate ()
+ */
+void history_prepare (history_t *history,const game_t *game);
+
+/*
+ * Keep what history_prepare () remembered, because the shape landed
+ * and the next one appeared
+ */
+void history_landed (history_t *history,const game_t *game);
+
+/*
+ * Take back the last pieces shapes that landed, so the game is where
+ * it was when the first of them appeared. The oldest shapes are
+ * forgotten once the history fills up. Returns the number of shapes
+ * taken back
+ */
+int history_rewind (history_t *history,game_t *game,int pieces);
+
+#endif	/* #ifndef HISTORY_H */
@@ -1,4 +1,3 @@
-
 /*
  * Copyright (c) Abraham vd Merwe <abz@blio.net>
  * All rights reserved.
@@ -27,39 +26,57 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/*
+ * The functions declared in io.h simply forward to the selected backend.
+ */
+
 #include <stdarg.h>		/* va_list(), va_start(), va_end() */
-#include <sys/time.h>	/* gettimeofday() */
-#include <unistd.h>		/* gettimeofday() */
+#include <stdio.h>		/* vsnprintf() */
+#include <string.h>		/* strcmp() */
 
 #include "io.h"
+#include "profile.h"
 
-/* Number of colors defined in io.h */
-#define NUM_COLORS	8
+/* Backend used if none is selected */
+#ifndef IO_DEFAULT
+#define IO_DEFAULT io_ncurses
+#endif
 
-/* Number of attributes defined in io.h */
-#define NUM_ATTRS	9
+/* Maximum length of a string written with out_printf() */
+#define MAXPRINT 256
 
-/* Cursor definitions */
-#define CURSOR_INVISIBLE	0
-#define CURSOR_NORMAL		1
+static const io_backend_t *backends[] = { &io_ncurses, &io_ansi, &io_slow, &io_null, NULL };
 
-/* Maps color definitions onto their real definitions */
-static int color_map[NUM_COLORS];
+static const io_backend_t *io = &IO_DEFAULT;
 
-/* Maps attribute definitions onto their real definitions */
-static int attr_map[NUM_ATTRS];
-
-/* Current attribute used on screen */
-static int out_attr;
+/*
+ * Backends
+ */
 
-/* Current color used on screen */
-static int out_color;
+/* Select the backend by name. Must be called before io_init (). Returns FALSE if there is no such backend */
+bool io_select (const char *name)
+{
+   int i;
+   for (i = 0; backends[i] != NULL; i++)
+	 if (strcmp (backends[i]->name,name) == 0)
+	   {
+		  io = backends[i];
+		  return TRUE;
+	   }
+   return FALSE;
+}
 
-/* This is the timeout in microseconds */
-static int in_timetotal;
+/* Name of the selected backend */
+const char *io_name ()
+{
+   return io->name;
+}
 
-/* This is the amount of time left to before a timeout occurs (in microseconds) */
-static int in_timeleft;
+/* Use a backend that isn't in the list io_select () knows about */
+void io_use (const io_backend_t *backend)
+{
+   io = backend;
+}
 
 /*
  * Init & Close
@@ -68,42 +85,13 @@ static int in_timeleft;
 /* Initialize screen */
 void io_init ()
 {
-   initscr ();
-   start_color ();
-   curs_set (CURSOR_INVISIBLE);
-   out_attr = A_NORMAL;
-   out_color = COLOR_WHITE;
-   noecho ();
-   /* Map colors */
-   color_map[COLOR_BLACK] = COLOR_BLACK;
-   color_map[COLOR_RED] = COLOR_RED;
-   color_map[COLOR_GREEN] = COLOR_GREEN;
-   color_map[COLOR_YELLOW] = COLOR_YELLOW;
-   color_map[COLOR_BLUE] = COLOR_BLUE;
-   color_map[COLOR_MAGENTA] = COLOR_MAGENTA;
-   color_map[COLOR_CYAN] = COLOR_CYAN;
-   color_map[COLOR_WHITE] = COLOR_WHITE;
-   /* Map attributes */
-   attr_map[ATTR_OFF] = A_NORMAL;
-   attr_map[ATTR_BOLD] = A_BOLD;
-   attr_map[ATTR_DIM] = A_DIM;
-   attr_map[ATTR_UNDERLINE] = A_UNDERLINE;
-   attr_map[ATTR_BLINK] = A_BLINK;
-   attr_map[ATTR_REVERSE] = A_REVERSE;
-   attr_map[ATTR_INVISIBLE] = A_INVIS;
-
-  keypad(stdscr, TRUE);
+   io->init ();
 }
 
 /* Restore original screen state */
 void io_close ()
 {
-   echo ();
-   attrset (A_NORMAL);
-   clear ();
-   curs_set (CURSOR_NORMAL);
-   refresh ();
-   endwin ();
+   io->close ();
 }
 
 /*
@@ -113,61 +101,61 @@ void io_close ()
 /* Set color attributes */
 void out_setattr (int attr)
 {
-   out_attr = attr_map[attr];
+   io->setattr (attr);
 }
 
 /* Set color */
 void out_setcolor (int fg,int bg)
 {
-   out_color = (color_map[bg] << 3) + color_map[fg];
-   init_pair (out_color,color_map[fg],color_map[bg]);
-   attrset (COLOR_PAIR (out_color) | out_attr);
+   io->setcolor (fg,bg);
 }
 
 /* Move cursor to position (x,y) on the screen. Upper corner of screen is (0,0) */
 void out_gotoxy (int x,int y)
 {
-   move (y,x);
+   io->gotoxy (x,y);
 }
 
 /* Put a character on the screen */
 void out_putch (char ch)
 {
-   addch (ch);
+   io->putch (ch);
 }
 
-/* Put a unicode character on the screen */
-/* Put a string on the screen */
+/* Write a string to the screen */
 void out_printf (char *format, ...)
 {
+   char buf[MAXPRINT];
    va_list ap;
    va_start (ap,format);
-   vw_printw (stdscr,format,ap);
+   vsnprintf (buf,sizeof (buf),format,ap);
    va_end (ap);
+   io->print (buf);
 }
 
 /* Refresh screen */
 void out_refresh ()
 {
-   refresh ();
+   PROFILE_ZONE (ZONE_REFRESH);
+   io->update ();
 }
 
 /* Get the screen width */
 int out_width ()
 {
-   return COLS;
+   return io->width ();
 }
 
 /* Get the screen height */
 int out_height ()
 {
-   return LINES;
+   return io->height ();
 }
 
 /* Beep */
 void out_beep ()
 {
-   beep ();
+   io->beep ();
 }
 
 /*
@@ -177,41 +165,18 @@ void out_beep ()
 /* Read a character. Please note that you MUST call in_timeout() before in_getch() */
 int in_getch ()
 {
-   struct timeval starttv,endtv;
-   int ch;
-   timeout (in_timeleft / 1000);
-   gettimeofday (&starttv,NULL);
-   ch = getch ();
-   gettimeofday (&endtv,NULL);
-   /* Timeout? */
-   if (ch == ERR)
-	 in_timeleft = in_timetotal;
-   /* No? Then calculate time left */
-   else
-	 {
-		endtv.tv_sec -= starttv.tv_sec;
-		endtv.tv_usec -= starttv.tv_usec;
-		if (endtv.tv_usec < 0)
-		  {
-			 endtv.tv_usec += 1000000;
-			 endtv.tv_sec--;
-		  }
-		in_timeleft -= endtv.tv_usec;
-		if (in_timeleft <= 0) in_timeleft = in_timetotal;
-	 }
-   return ch;
+   PROFILE_ZONE (ZONE_GETCH);
+   return io->getkey ();
 }
 
 /* Set keyboard timeout in microseconds */
 void in_timeout (int delay)
 {
-   /* ncurses timeout() function works with milliseconds, not microseconds */
-   in_timetotal = in_timeleft = delay;
+   io->settimeout (delay);
 }
 
 /* Empty keyboard buffer */
 void in_flush ()
 {
-   flushinp ();
+   io->flush ();
 }
-
@@ -57,6 +57,82 @@
 #define ATTR_REVERSE    7                        /* Reverse Video On */
 #define ATTR_INVISIBLE  8                        /* Concealed On */
 
+/*
+ * Backends
+ */
+
+typedef struct
+{
+   const char *name;
+   void (*init) ();
+   void (*close) ();
+   void (*setattr) (int attr);
+   void (*setcolor) (int fg,int bg);
+   void (*gotoxy) (int x,int y);
+   void (*putch) (char ch);
+   void (*print) (const char *str);
+   void (*update) ();
+   int (*width) ();
+   int (*height) ();
+   void (*beep) ();
+   int (*getkey) ();
+   void (*settimeout) (int delay);
+   void (*flush) ();
+} io_backend_t;
+
+/* Draws with the curses library */
+extern const io_backend_t io_ncurses;
+
+/* Writes ANSI escape sequences, one write() per frame */
+extern const io_backend_t io_ansi;
+
+/* Like io_ansi, but drops frames while the line is busy */
+extern const io_backend_t io_slow;
+
+/* Draws nowhere, counts what would have been drawn */
+extern const io_backend_t io_null;
+
+/* Select the backend by name. Must be called before io_init (). Returns FALSE if there is no such backend */
+bool io_select (const char *name);
+
+/* Name of the selected backend */
+const char *io_name ();
+
+/* Use a backend that isn't in the list io_select () knows about */
+void io_use (const io_backend_t *backend);
+
+/*
+ * ANSI renderers
+ */
+
+typedef struct ansi_struct ansi_t;
+
+/* Receives each encoded frame */
+typedef void (*ansi_sink_t) (void *arg,const char *frame,size_t len);
+
+/* Frames are skipped while this returns TRUE */
+typedef bool (*ansi_busy_t) (void *arg);
+
+/* Create a renderer for a width x height terminal. Returns NULL if out of memory */
+ansi_t *ansi_new (int width,int height,ansi_sink_t sink,ansi_busy_t busy,void *arg);
+
+/* Free a renderer created with ansi_new () */
+void ansi_free (ansi_t *renderer);
+
+/* Make io_ansi draw with this renderer in the calling thread, or with the terminal if it is NULL */
+void ansi_use (ansi_t *renderer);
+
+/* Also hand every frame written to our own terminal to sink, e.g. to record the session. */
+/* The sink may call ansi_keyframe () for our terminal. NULL stops */
+void ansi_tap (ansi_sink_t sink,void *arg);
+
+/* Encode everything the terminal of a renderer (our own if it is NULL) shows as a frame for */
+/* another terminal, which can then follow the renderer's frames from there */
+void ansi_keyframe (ansi_t *renderer,ansi_sink_t sink,void *arg);
+
+/* Split whatever a terminal sent into keys, translating cursor keys. Returns the number of keys stored */
+int ansi_keys (const unsigned char *buf,int len,int *keys,int maxkeys);
+
 /*
  * Init & Close
  */
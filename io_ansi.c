@@ -0,0 +1,792 @@
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Raw ANSI/VT100 output backend. Everything
+ * drawn goes into an in-memory copy of the screen. out_refresh () compares
+ * it with what the terminal is known to show, encodes only the differences
+ * into a preallocated frame buffer and flushes that with a single write ().
+ *
+ * All drawing state lives in an ansi_t, so other programs (tint-server) can
+ * keep one renderer per remote terminal and point io_ansi at it with
+ * ansi_use (). Input and terminal handling always apply to our own tty.
+ */
+
+#include <stdio.h>		/* snprintf() */
+#include <stdlib.h>		/* malloc(), free() */
+#include <limits.h>		/* INT_MAX */
+#include <string.h>		/* memcpy(), memset() */
+#include <errno.h>		/* errno */
+#include <signal.h>		/* signal(), raise() */
+#include <termios.h>	/* tcgetattr(), tcsetattr(), tcflush() */
+#include <unistd.h>		/* read(), write() */
+#include <sys/ioctl.h>	/* ioctl(), TIOCGWINSZ */
+#include <sys/select.h>	/* select() */
+#include <sys/time.h>	/* gettimeofday() */
+
+#include "io.h"
+
+/* Screen size used if the terminal doesn't know its own */
+#define DEFAULT_WIDTH	80
+#define DEFAULT_HEIGHT	24
+
+/* Worst case number of bytes needed to update a single cell */
+#define CELL_BYTES	32
+
+/* Bytes reserved in the frame buffer for the bell, mode switches, etc. */
+#define FRAME_SLACK	128
+
+/* Color value of cells that still have the terminal's default colors */
+#define COLOR_DEFAULT	0xff
+
+/* Maximum number of decoded keys waiting to be read */
+#define MAXKEYS		32
+
+/* How often (in microseconds) we look whether a slow line has room for a frame that was held back */
+#define HOLDPOLL	20000
+
+typedef struct
+{
+   char ch;
+   unsigned char color;		/* (bg << 3) + fg */
+   unsigned char attr;		/* ATTR_* */
+} cell_t;
+
+struct ansi_struct
+{
+   cell_t *screen,*term;					/* what the game has drawn and what the terminal currently shows */
+   int width,height;						/* screen dimensions */
+   int curx,cury;							/* drawing cursor */
+   int out_color,out_attr,next_attr;		/* pen used for drawing, the attribute only takes effect with the next color change */
+   int term_x,term_y,term_color,term_attr;	/* terminal cursor and pen, -1 if unknown */
+   char *frame;								/* frame buffer */
+   size_t framelen;
+   bool bell;								/* ring the bell with the next frame */
+   ansi_sink_t sink;						/* where frames go */
+   ansi_busy_t busy;						/* frames are skipped while this returns TRUE */
+   bool held;								/* a frame was skipped and is still to be sent */
+   void *arg;								/* passed to sink () and busy () */
+};
+
+/* Renderer for the terminal we run on */
+static ansi_t console;
+
+/* Renderer drawn with in this thread */
+static __thread ansi_t *ansi = &console;
+
+/* Also gets every frame of our own terminal, if set */
+static ansi_sink_t tap;
+static void *taparg;
+
+/* Skip frames when output is backing up */
+static bool lowbandwidth;
+
+/* Most bytes we allow to be waiting for the line in low bandwidth mode */
+static int maxqueue;
+
+/* Terminal settings to restore on exit */
+static struct termios saved_tio;
+
+/* This is the timeout in microseconds */
+static int in_timetotal;
+
+/* This is the amount of time left to before a timeout occurs (in microseconds) */
+static int in_timeleft;
+
+/* Decoded keys waiting to be read */
+static int keys[MAXKEYS],numkeys;
+
+/*
+ * Frame buffer
+ */
+
+static void emit (const char *str,size_t len)
+{
+   memcpy (ansi->frame + ansi->framelen,str,len);
+   ansi->framelen += len;
+}
+
+static void emits (const char *str)
+{
+   emit (str,strlen (str));
+}
+
+static void emitn (int n)
+{
+   char tmp[12];
+   emit (tmp,snprintf (tmp,sizeof (tmp),"%d",n));
+}
+
+/* Hand the frame buffer to the sink. The frame stays in the buffer until the next one is encoded */
+static void flush_frame ()
+{
+   size_t len = ansi->framelen;
+   if (!len) return;
+   ansi->framelen = 0;
+   ansi->sink (ansi->arg,ansi->frame,len);
+   if (ansi == &console && tap != NULL) tap (taparg,ansi->frame,len);
+}
+
+/* Write a frame to the terminal with (normally) a single system call */
+static void console_sink (void *arg,const char *frame,size_t len)
+{
+   size_t ofs = 0;
+   ssize_t result;
+   while (ofs < len)
+	 {
+		result = write (STDOUT_FILENO,frame + ofs,len - ofs);
+		if (result < 0)
+		  {
+			 if (errno == EINTR) continue;
+			 break;
+		  }
+		ofs += result;
+	 }
+}
+
+/*
+ * Encoding
+ */
+
+/* Number of bytes in a cursor movement sequence with count n */
+static int seq_cost (int n)
+{
+   return (n == 1 ? 3 : n < 10 ? 4 : n < 100 ? 5 : 6);
+}
+
+/* Number of bytes needed to move the cursor to (x,y) with an absolute move */
+static int cup_cost (int x,int y)
+{
+   return ((x ? 6 + (x >= 9) + (x >= 99) : 4) + (y >= 9) + (y >= 99));
+}
+
+/* Check if a cell looks the same when drawn with the current terminal pen */
+static bool fits_pen (const cell_t *cell)
+{
+   if (cell->color == ansi->term_color && cell->attr == ansi->term_attr) return TRUE;
+   /* The foreground and most attributes don't show on a blank */
+   return (cell->ch == ' ' && ansi->term_color >= 0 && (cell->color >> 3) == (ansi->term_color >> 3) &&
+		   cell->attr != ATTR_UNDERLINE && cell->attr != ATTR_REVERSE &&
+		   ansi->term_attr != ATTR_UNDERLINE && ansi->term_attr != ATTR_REVERSE);
+}
+
+/* Check if two cells look the same on the screen */
+static bool same_look (const cell_t *a,const cell_t *b)
+{
+   if (a->ch != b->ch) return FALSE;
+   if (a->color == b->color && a->attr == b->attr) return TRUE;
+   return (a->ch == ' ' && (a->color >> 3) == (b->color >> 3) &&
+		   a->attr != ATTR_UNDERLINE && a->attr != ATTR_REVERSE &&
+		   b->attr != ATTR_UNDERLINE && b->attr != ATTR_REVERSE);
+}
+
+/* Check if the cells from x0 up to x1 on row y can be redrawn without changing the pen */
+static bool can_overwrite (int x0,int x1,int y)
+{
+   int i;
+   for (i = x0; i < x1; i++) if (!fits_pen (&ansi->term[y * ansi->width + i])) return FALSE;
+   return TRUE;
+}
+
+/* Number of bytes needed to move the cursor vertically by dy rows */
+static int vmove_cost (int dy)
+{
+   if (dy > 0) return (dy < seq_cost (dy) ? dy : seq_cost (dy));
+   return (dy ? seq_cost (-dy) : 0);
+}
+
+/* Number of bytes needed to move the cursor on row y from column x0 to x1 */
+static int hmove_cost (int x0,int x1,int y)
+{
+   if (x1 > x0) return (x1 - x0 < seq_cost (x1 - x0) && can_overwrite (x0,x1,y) ? x1 - x0 : seq_cost (x1 - x0));
+   if (x1 < x0) return (x0 - x1 < seq_cost (x0 - x1) ? x0 - x1 : seq_cost (x0 - x1));
+   return (0);
+}
+
+static void emit_seq (int n,char cmd)
+{
+   emits ("\033[");
+   if (n != 1) emitn (n);
+   emit (&cmd,1);
+}
+
+static void emit_vmove (int dy)
+{
+   if (dy > 0 && dy < seq_cost (dy)) while (dy--) emits ("\n");
+   else if (dy > 0) emit_seq (dy,'B');
+   else if (dy < 0) emit_seq (-dy,'A');
+}
+
+static void emit_hmove (int x0,int x1,int y)
+{
+   int i;
+   if (x1 > x0 && x1 - x0 < seq_cost (x1 - x0) && can_overwrite (x0,x1,y))
+	 for (i = x0; i < x1; i++) emit (&ansi->term[y * ansi->width + i].ch,1);
+   else if (x1 > x0) emit_seq (x1 - x0,'C');
+   else if (x1 < x0 && x0 - x1 < seq_cost (x0 - x1)) for (i = x1; i < x0; i++) emits ("\b");
+   else if (x1 < x0) emit_seq (x0 - x1,'D');
+}
+
+/* Move the terminal cursor to (x,y), using whichever of an absolute move, */
+/* a relative move or a carriage return followed by a relative move is shortest */
+static void move_cursor (int x,int y)
+{
+   int absolute,relative = INT_MAX,cr = INT_MAX;
+   if (ansi->term_x == x && ansi->term_y == y) return;
+   absolute = cup_cost (x,y);
+   if (ansi->term_y >= 0)
+	 {
+		if (ansi->term_x >= 0) relative = vmove_cost (y - ansi->term_y) + hmove_cost (ansi->term_x,x,y);
+		cr = 1 + vmove_cost (y - ansi->term_y) + hmove_cost (0,x,y);
+	 }
+   if (relative <= absolute && relative <= cr)
+	 {
+		emit_vmove (y - ansi->term_y);
+		emit_hmove (ansi->term_x,x,y);
+	 }
+   else if (cr <= absolute)
+	 {
+		emits ("\r");
+		emit_vmove (y - ansi->term_y);
+		emit_hmove (0,x,y);
+	 }
+   else
+	 {
+		emits ("\033[");
+		emitn (y + 1);
+		if (x)
+		  {
+			 emits (";");
+			 emitn (x + 1);
+		  }
+		emits ("H");
+	 }
+   ansi->term_x = x;
+   ansi->term_y = y;
+}
+
+/* Switch the terminal to the given pen, sending only what changed */
+static void set_pen (int color,int attr)
+{
+   bool sep = FALSE;
+   if (color == ansi->term_color && attr == ansi->term_attr) return;
+   emits ("\033[");
+   /* Attributes can only be switched off all at once */
+   if (attr != ansi->term_attr)
+	 {
+		if (ansi->term_attr != ATTR_OFF || attr == ATTR_OFF)
+		  {
+			 emits ("0");
+			 sep = TRUE;
+			 ansi->term_color = -1;
+		  }
+		if (attr != ATTR_OFF)
+		  {
+			 if (sep) emits (";");
+			 emitn (attr);
+			 sep = TRUE;
+		  }
+	 }
+   /* The terminal's default colors could be anything, so they're never taken for ours */
+   if (ansi->term_color < 0 || ansi->term_color == COLOR_DEFAULT || (color & 7) != (ansi->term_color & 7))
+	 {
+		if (sep) emits (";");
+		emitn (30 + (color & 7));
+		sep = TRUE;
+	 }
+   if (ansi->term_color < 0 || ansi->term_color == COLOR_DEFAULT || (color >> 3) != (ansi->term_color >> 3))
+	 {
+		if (sep) emits (";");
+		emitn (40 + (color >> 3));
+	 }
+   emits ("m");
+   ansi->term_color = color;
+   ansi->term_attr = attr;
+}
+
+/* Encode the differences between the screen and the terminal */
+static void encode_frame ()
+{
+   int x,y;
+   cell_t *cell,*shown;
+   for (y = 0; y < ansi->height; y++)
+	 for (x = 0; x < ansi->width; x++)
+	   {
+		  cell = &ansi->screen[y * ansi->width + x];
+		  shown = &ansi->term[y * ansi->width + x];
+		  if (same_look (cell,shown)) continue;
+		  move_cursor (x,y);
+		  if (!fits_pen (cell)) set_pen (cell->color,cell->attr);
+		  emit (&cell->ch,1);
+		  *shown = *cell;
+		  /* The column is undefined after writing the last one, but a carriage return still works */
+		  ansi->term_x = x + 1 < ansi->width ? x + 1 : -1;
+	   }
+   if (ansi->bell)
+	 {
+		emits ("\a");
+		ansi->bell = FALSE;
+	 }
+}
+
+/* Encode everything the terminal of a renderer shows as a frame of its own, for */
+/* another terminal in an unknown state. The frame leaves the cursor and pen where */
+/* the next frame of the renderer expects them */
+void ansi_keyframe (ansi_t *renderer,ansi_sink_t sink,void *arg)
+{
+   if (renderer == NULL) renderer = &console;
+   static const cell_t blank = { ' ', COLOR_DEFAULT, ATTR_OFF };
+   ansi_t *saved = ansi;
+   int x,y,term_x,term_y,term_color,term_attr;
+   size_t start;
+   cell_t *cell;
+   ansi = renderer;
+   /* Anything not flushed yet stays in front of the frame buffer */
+   start = ansi->framelen;
+   term_x = ansi->term_x;
+   term_y = ansi->term_y;
+   term_color = ansi->term_color;
+   term_attr = ansi->term_attr;
+   emits ("\033[?25l\033[0m\033[2J\033[H");
+   ansi->term_x = ansi->term_y = 0;
+   ansi->term_color = COLOR_DEFAULT;
+   ansi->term_attr = ATTR_OFF;
+   for (y = 0; y < ansi->height; y++)
+	 for (x = 0; x < ansi->width; x++)
+	   {
+		  cell = &ansi->term[y * ansi->width + x];
+		  if (same_look (cell,&blank)) continue;
+		  move_cursor (x,y);
+		  if (!fits_pen (cell)) set_pen (cell->color,cell->attr);
+		  emit (&cell->ch,1);
+		  ansi->term_x = x + 1 < ansi->width ? x + 1 : -1;
+	   }
+   if (term_y >= 0) move_cursor (term_x >= 0 ? term_x : 0,term_y);
+   if (term_color != COLOR_DEFAULT) set_pen (term_color,term_attr);
+   else if (ansi->term_color != COLOR_DEFAULT || ansi->term_attr != ATTR_OFF) emits ("\033[0m");
+   sink (arg,ansi->frame + start,ansi->framelen - start);
+   ansi->framelen = start;
+   ansi->term_x = term_x;
+   ansi->term_y = term_y;
+   ansi->term_color = term_color;
+   ansi->term_attr = term_attr;
+   ansi = saved;
+}
+
+/* In low bandwidth mode, hold back frames while earlier ones are still queued for the line */
+static bool console_busy (void *arg)
+{
+   int pending;
+   if (!lowbandwidth || ioctl (STDOUT_FILENO,TIOCOUTQ,&pending) < 0) return FALSE;
+   return (pending > maxqueue);
+}
+
+/* Bytes per second the terminal line can carry */
+static int line_rate ()
+{
+   static const struct { speed_t speed; int bps; } rates[] =
+	 {
+		{ B300, 300 }, { B1200, 1200 }, { B2400, 2400 }, { B4800, 4800 },
+		{ B9600, 9600 }, { B19200, 19200 }, { B38400, 38400 }, { B57600, 57600 },
+		{ B115200, 115200 }
+	 };
+   struct termios tio;
+   int i;
+   if (tcgetattr (STDOUT_FILENO,&tio) == 0)
+	 for (i = 0; i < sizeof (rates) / sizeof (rates[0]); i++)
+	   if (cfgetospeed (&tio) == rates[i].speed) return (rates[i].bps / 10);
+   return (115200 / 10);
+}
+
+/*
+ * Signals
+ */
+
+static void restore_terminal ()
+{
+   static const char reset[] = "\033[0m\033[2J\033[H\033[?25h\033[?1049l";
+   tcsetattr (STDIN_FILENO,TCSANOW,&saved_tio);
+   write (STDOUT_FILENO,reset,sizeof (reset) - 1);
+}
+
+static void sighandler (int sig)
+{
+   restore_terminal ();
+   signal (sig,SIG_DFL);
+   raise (sig);
+}
+
+/*
+ * Init & Close
+ */
+
+/* Allocate the screens of a renderer and start its first frame with preamble */
+static bool setup (ansi_t *renderer,int width,int height,const char *preamble)
+{
+   int i;
+   renderer->width = width;
+   renderer->height = height;
+   renderer->screen = malloc (width * height * sizeof (cell_t));
+   renderer->term = malloc (width * height * sizeof (cell_t));
+   renderer->frame = malloc (width * height * CELL_BYTES + FRAME_SLACK);
+   if (renderer->screen == NULL || renderer->term == NULL || renderer->frame == NULL)
+	 {
+		free (renderer->screen);
+		free (renderer->term);
+		free (renderer->frame);
+		return FALSE;
+	 }
+   /* After clearing, every cell is a blank in the terminal's default colors */
+   for (i = 0; i < width * height; i++)
+	 {
+		renderer->screen[i].ch = ' ';
+		renderer->screen[i].color = COLOR_DEFAULT;
+		renderer->screen[i].attr = ATTR_OFF;
+	 }
+   memcpy (renderer->term,renderer->screen,width * height * sizeof (cell_t));
+   renderer->curx = renderer->cury = 0;
+   renderer->out_color = COLOR_WHITE;
+   renderer->out_attr = renderer->next_attr = ATTR_OFF;
+   renderer->term_x = renderer->term_y = 0;
+   renderer->term_color = COLOR_DEFAULT;
+   renderer->term_attr = ATTR_OFF;
+   renderer->framelen = strlen (preamble);
+   memcpy (renderer->frame,preamble,renderer->framelen);
+   renderer->bell = FALSE;
+   return TRUE;
+}
+
+/* Create a renderer for a width x height terminal */
+ansi_t *ansi_new (int width,int height,ansi_sink_t sink,ansi_busy_t busy,void *arg)
+{
+   ansi_t *renderer;
+   if ((renderer = malloc (sizeof (ansi_t))) == NULL) return NULL;
+   /* Invisible cursor, clear screen */
+   if (!setup (renderer,width,height,"\033[?25l\033[0m\033[2J\033[H"))
+	 {
+		free (renderer);
+		return NULL;
+	 }
+   renderer->sink = sink;
+   renderer->busy = busy;
+   renderer->arg = arg;
+   return renderer;
+}
+
+/* Free a renderer created with ansi_new () */
+void ansi_free (ansi_t *renderer)
+{
+   if (ansi == renderer) ansi = &console;
+   free (renderer->screen);
+   free (renderer->term);
+   free (renderer->frame);
+   free (renderer);
+}
+
+/* Make io_ansi draw with this renderer in the calling thread, or with the terminal if it is NULL */
+void ansi_use (ansi_t *renderer)
+{
+   ansi = renderer != NULL ? renderer : &console;
+}
+
+/* Also hand every frame written to our own terminal to sink, or stop if it is NULL */
+void ansi_tap (ansi_sink_t sink,void *arg)
+{
+   tap = sink;
+   taparg = arg;
+}
+
+/* Initialize screen */
+static void ansi_init ()
+{
+   struct termios tio;
+   struct winsize ws;
+   int width = DEFAULT_WIDTH,height = DEFAULT_HEIGHT;
+   if (ioctl (STDOUT_FILENO,TIOCGWINSZ,&ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0)
+	 {
+		width = ws.ws_col;
+		height = ws.ws_row;
+	 }
+   /* Alternate screen, invisible cursor, clear screen */
+   if (!setup (&console,width,height,"\033[?1049h\033[?25l\033[0m\033[2J\033[H"))
+	 {
+		fprintf (stderr,"Out of memory\n");
+		exit (EXIT_FAILURE);
+	 }
+   console.sink = console_sink;
+   console.busy = console_busy;
+   console.arg = NULL;
+   lowbandwidth = FALSE;
+   numkeys = 0;
+   /* No line buffering, no echo and no translation of newlines on output */
+   tcgetattr (STDIN_FILENO,&saved_tio);
+   tio = saved_tio;
+   tio.c_lflag &= ~(ICANON | ECHO);
+   tio.c_oflag &= ~OPOST;
+   tio.c_cc[VMIN] = 1;
+   tio.c_cc[VTIME] = 0;
+   tcsetattr (STDIN_FILENO,TCSANOW,&tio);
+   signal (SIGINT,sighandler);
+   signal (SIGTERM,sighandler);
+   signal (SIGHUP,sighandler);
+   ansi = &console;
+   flush_frame ();
+}
+
+/* Initialize screen for a slow line. Allow about a tenth of a second of output to queue up */
+static void slow_init ()
+{
+   ansi_init ();
+   lowbandwidth = TRUE;
+   maxqueue = line_rate () / 10;
+}
+
+/* Restore original screen state */
+static void ansi_close ()
+{
+   restore_terminal ();
+   signal (SIGINT,SIG_DFL);
+   signal (SIGTERM,SIG_DFL);
+   signal (SIGHUP,SIG_DFL);
+   free (console.screen);
+   free (console.term);
+   free (console.frame);
+}
+
+/*
+ * Output
+ */
+
+/* Set color attributes */
+static void ansi_setattr (int attr)
+{
+   ansi->next_attr = attr;
+}
+
+/* Set color */
+static void ansi_setcolor (int fg,int bg)
+{
+   ansi->out_color = (bg << 3) + fg;
+   ansi->out_attr = ansi->next_attr;
+}
+
+/* Move cursor to position (x,y) on the screen. Upper corner of screen is (0,0) */
+static void ansi_gotoxy (int x,int y)
+{
+   ansi->curx = x;
+   ansi->cury = y;
+}
+
+/* Put a character on the screen */
+static void ansi_putch (char ch)
+{
+   cell_t *cell;
+   if (ch == '\n')
+	 {
+		ansi->curx = 0;
+		ansi->cury++;
+		return;
+	 }
+   if (ansi->curx >= 0 && ansi->curx < ansi->width && ansi->cury >= 0 && ansi->cury < ansi->height)
+	 {
+		cell = &ansi->screen[ansi->cury * ansi->width + ansi->curx];
+		cell->ch = ch;
+		cell->color = ansi->out_color;
+		cell->attr = ansi->out_attr;
+	 }
+   if (++ansi->curx >= ansi->width)
+	 {
+		ansi->curx = 0;
+		ansi->cury++;
+	 }
+}
+
+/* Put a string on the screen */
+static void ansi_print (const char *str)
+{
+   while (*str) ansi_putch (*str++);
+}
+
+/* Refresh screen */
+static void ansi_refresh ()
+{
+   if ((ansi->held = ansi->busy != NULL && ansi->busy (ansi->arg))) return;
+   encode_frame ();
+   flush_frame ();
+}
+
+/* Send the frame held back for our own terminal, if the line has room for it now */
+static void send_held ()
+{
+   ansi_t *saved = ansi;
+   if (console_busy (NULL)) return;
+   ansi = &console;
+   console.held = FALSE;
+   encode_frame ();
+   flush_frame ();
+   ansi = saved;
+}
+
+/* Get the screen width */
+static int ansi_width ()
+{
+   return ansi->width;
+}
+
+/* Get the screen height */
+static int ansi_height ()
+{
+   return ansi->height;
+}
+
+/* Beep */
+static void ansi_beep ()
+{
+   ansi->bell = TRUE;
+}
+
+/*
+ * Input
+ */
+
+/* Split whatever a terminal sent into keys, translating cursor keys. Returns the number of keys stored */
+int ansi_keys (const unsigned char *buf,int len,int *keys,int maxkeys)
+{
+   int i = 0,n = 0,key;
+   while (i < len && n < maxkeys)
+	 {
+		key = buf[i++];
+		if (key == 27 && i + 1 < len && (buf[i] == '[' || buf[i] == 'O'))
+		  {
+			 switch (buf[i + 1])
+			   {
+				case 'A': key = KEY_UP; break;
+				case 'B': key = KEY_DOWN; break;
+				case 'C': key = KEY_RIGHT; break;
+				case 'D': key = KEY_LEFT; break;
+			   }
+			 if (key != 27) i += 2;
+		  }
+		keys[n++] = key;
+	 }
+   return n;
+}
+
+static int next_key ()
+{
+   int key = keys[0];
+   memmove (keys,keys + 1,--numkeys * sizeof (int));
+   return key;
+}
+
+/* Read a character. Please note that you MUST call in_timeout() before in_getch() */
+static int ansi_getch ()
+{
+   struct timeval starttv,endtv,tv;
+   unsigned char buf[MAXKEYS];
+   fd_set fds;
+   int n,left = in_timeleft,wait;
+   if (numkeys) return next_key ();
+   gettimeofday (&starttv,NULL);
+   /* Nothing may be drawn for a while, so a frame held back for the line goes out from here */
+   do
+	 {
+		wait = console.held && left > HOLDPOLL ? HOLDPOLL : left;
+		tv.tv_sec = wait / 1000000;
+		tv.tv_usec = wait % 1000000;
+		FD_ZERO (&fds);
+		FD_SET (STDIN_FILENO,&fds);
+		n = select (STDIN_FILENO + 1,&fds,NULL,NULL,&tv);
+		if (n > 0 && (n = read (STDIN_FILENO,buf,sizeof (buf))) > 0) numkeys += ansi_keys (buf,n,keys + numkeys,MAXKEYS - numkeys);
+		if (console.held) send_held ();
+		left -= wait;
+	 }
+   while (!numkeys && n >= 0 && left > 0);
+   /* Timeout? */
+   if (!numkeys)
+	 {
+		in_timeleft = in_timetotal;
+		return ERR;
+	 }
+   /* No? Then calculate time left */
+   gettimeofday (&endtv,NULL);
+   in_timeleft -= (endtv.tv_sec - starttv.tv_sec) * 1000000 + (endtv.tv_usec - starttv.tv_usec);
+   if (in_timeleft <= 0) in_timeleft = in_timetotal;
+   return next_key ();
+}
+
+/* Set keyboard timeout in microseconds */
+static void ansi_timeout (int delay)
+{
+   in_timetotal = in_timeleft = delay;
+}
+
+/* Empty keyboard buffer */
+static void ansi_flush ()
+{
+   numkeys = 0;
+   tcflush (STDIN_FILENO,TCIFLUSH);
+}
+
+const io_backend_t io_ansi =
+{
+   "ansi",
+   ansi_init,
+   ansi_close,
+   ansi_setattr,
+   ansi_setcolor,
+   ansi_gotoxy,
+   ansi_putch,
+   ansi_print,
+   ansi_refresh,
+   ansi_width,
+   ansi_height,
+   ansi_beep,
+   ansi_getch,
+   ansi_timeout,
+   ansi_flush
+};
+
+const io_backend_t io_slow =
+{
+   "slow",
+   slow_init,
+   ansi_close,
+   ansi_setattr,
+   ansi_setcolor,
+   ansi_gotoxy,
+   ansi_putch,
+   ansi_print,
+   ansi_refresh,
+   ansi_width,
+   ansi_height,
+   ansi_beep,
+   ansi_getch,
+   ansi_timeout,
+   ansi_flush
+};
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Null output backend. Nothing is drawn and no key is ever pressed, so the
+ * game runs its real drawing code as fast as it can without a terminal. It
+ * keeps count of what would have been drawn and reports it on exit.
+ */
+
+#include <stdio.h>		/* fprintf() */
+#include <string.h>		/* strlen() */
+
+#include "io.h"
+
+/* Size of the pretend screen */
+#define NULL_WIDTH	80
+#define NULL_HEIGHT	24
+
+static struct
+{
+   unsigned long frames;
+   unsigned long chars;
+   unsigned long moves;
+   unsigned long colors;
+   unsigned long attrs;
+   unsigned long reads;
+} stats;
+
+/*
+ * Init & Close
+ */
+
+/* Initialize screen */
+static void null_init ()
+{
+   memset (&stats,0,sizeof (stats));
+}
+
+/* Report what would have been drawn */
+static void null_close ()
+{
+   fprintf (stderr,
+			"null renderer: %lu frames, %lu characters, %lu cursor moves, %lu color changes, %lu attribute changes, %lu reads\n",
+			stats.frames,stats.chars,stats.moves,stats.colors,stats.attrs,stats.reads);
+}
+
+/*
+ * Output
+ */
+
+/* Set color attributes */
+static void null_setattr (int attr)
+{
+   stats.attrs++;
+}
+
+/* Set color */
+static void null_setcolor (int fg,int bg)
+{
+   stats.colors++;
+}
+
+/* Move cursor to position (x,y) on the screen. Upper corner of screen is (0,0) */
+static void null_gotoxy (int x,int y)
+{
+   stats.moves++;
+}
+
+/* Put a character on the screen */
+static void null_putch (char ch)
+{
+   stats.chars++;
+}
+
+/* Put a string on the screen */
+static void null_print (const char *str)
+{
+   stats.chars += strlen (str);
+}
+
+/* Refresh screen */
+static void null_refresh ()
+{
+   stats.frames++;
+}
+
+/* Get the screen width */
+static int null_width ()
+{
+   return NULL_WIDTH;
+}
+
+/* Get the screen height */
+static int null_height ()
+{
+   return NULL_HEIGHT;
+}
+
+/* Beep */
+static void null_beep ()
+{
+}
+
+/*
+ * Input
+ */
+
+/* Read a character. There never is one, so the timeout happens immediately */
+static int null_getch ()
+{
+   stats.reads++;
+   return ERR;
+}
+
+/* Set keyboard timeout in microseconds */
+static void null_timeout (int delay)
+{
+}
+
+/* Empty keyboard buffer */
+static void null_flush ()
+{
+}
+
+const io_backend_t io_null =
+{
+   "null",
+   null_init,
+   null_close,
+   null_setattr,
+   null_setcolor,
+   null_gotoxy,
+   null_putch,
+   null_print,
+   null_refresh,
+   null_width,
+   null_height,
+   null_beep,
+   null_getch,
+   null_timeout,
+   null_flush
+};
@@ -0,0 +1,325 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "typedefs.h"
+#include "pool.h"
+
+/*
+ * Type definitions
+ */
+
+typedef struct
+{
+   task_t task;
+   void *arg;
+} job_t;
+
+/* Jobs of one thread, oldest at head */
+typedef struct
+{
+   pthread_mutex_t lock;
+   job_t *jobs;
+   int head,count,size;
+} queue_t;
+
+typedef struct
+{
+   pool_t *pool;
+   int index;
+} worker_t;
+
+struct pool_struct
+{
+   int numthreads;
+   queue_t *queue;
+   pthread_t *thread;
+   worker_t *worker;
+   pthread_mutex_t lock;		/* protects everything below */
+   pthread_cond_t work;			/* a job was queued */
+   pthread_cond_t done;			/* the last job finished */
+   int queued;					/* jobs in the queues, or about to be */
+   int pending;					/* jobs queued or running */
+   int next;					/* queue for jobs from outside the pool */
+   bool helped;					/* a thread from outside is running jobs as thread 0 */
+   bool quit;
+};
+
+/*
+ * Global variables
+ */
+
+/* Thread we're running in, -1 outside the pool. The one helping in pool_wait () is 0 */
+static __thread int self = -1;
+
+/*
+ * Queues
+ */
+
+/* Add a job to a queue. Returns FALSE if we run out of memory */
+static bool push (queue_t *queue,const job_t *job)
+{
+   job_t *jobs;
+   int i;
+   pthread_mutex_lock (&queue->lock);
+   if (queue->count == queue->size)
+	 {
+		if ((jobs = malloc ((queue->size ? queue->size * 2 : 64) * sizeof (job_t))) == NULL)
+		  {
+			 pthread_mutex_unlock (&queue->lock);
+			 return (FALSE);
+		  }
+		for (i = 0; i < queue->count; i++) jobs[i] = queue->jobs[(queue->head + i) % queue->size];
+		free (queue->jobs);
+		queue->jobs = jobs;
+		queue->head = 0;
+		queue->size = queue->size ? queue->size * 2 : 64;
+	 }
+   queue->jobs[(queue->head + queue->count++) % queue->size] = *job;
+   pthread_mutex_unlock (&queue->lock);
+   return (TRUE);
+}
+
+/* Take the newest job from a queue, or the oldest if we're stealing */
+static bool pop (queue_t *queue,job_t *job,bool steal)
+{
+   bool found = FALSE;
+   pthread_mutex_lock (&queue->lock);
+   if (queue->count)
+	 {
+		if (steal)
+		  {
+			 *job = queue->jobs[queue->head];
+			 queue->head = (queue->head + 1) % queue->size;
+		  }
+		else *job = queue->jobs[(queue->head + queue->count - 1) % queue->size];
+		queue->count--;
+		found = TRUE;
+	 }
+   pthread_mutex_unlock (&queue->lock);
+   return (found);
+}
+
+/* Find a job for a thread: its own first, then one of someone else's */
+static bool take (pool_t *pool,int index,job_t *job)
+{
+   int i;
+   for (i = 0; i < pool->numthreads; i++)
+	 if (pop (&pool->queue[(index + i) % pool->numthreads],job,i > 0))
+	   {
+		  pthread_mutex_lock (&pool->lock);
+		  pool->queued--;
+		  pthread_mutex_unlock (&pool->lock);
+		  return (TRUE);
+	   }
+   return (FALSE);
+}
+
+/* Run a job and count it as done */
+static void run (pool_t *pool,const job_t *job)
+{
+   job->task (job->arg);
+   pthread_mutex_lock (&pool->lock);
+   if (!--pool->pending) pthread_cond_broadcast (&pool->done);
+   pthread_mutex_unlock (&pool->lock);
+}
+
+/* Threads started by the pool */
+static void *work (void *arg)
+{
+   worker_t *worker = arg;
+   pool_t *pool = worker->pool;
+   job_t job;
+   self = worker->index;
+   for (;;)
+	 {
+		if (take (pool,self,&job))
+		  {
+			 run (pool,&job);
+			 continue;
+		  }
+		pthread_mutex_lock (&pool->lock);
+		while (!pool->quit && !pool->queued) pthread_cond_wait (&pool->work,&pool->lock);
+		if (pool->quit)
+		  {
+			 pthread_mutex_unlock (&pool->lock);
+			 return (NULL);
+		  }
+		pthread_mutex_unlock (&pool->lock);
+	 }
+}
+
+/*
+ * Functions
+ */
+
+/* Create a pool of threads */
+pool_t *pool_new (int threads)
+{
+   pool_t *pool;
+   int i;
+   if (threads < 1) threads = 1;
+   if ((pool = calloc (1,sizeof (pool_t))) == NULL) return (NULL);
+   pool->numthreads = threads;
+   if ((pool->queue = calloc (threads,sizeof (queue_t))) == NULL ||
+	   (pool->thread = calloc (threads,sizeof (pthread_t))) == NULL ||
+	   (pool->worker = calloc (threads,sizeof (worker_t))) == NULL)
+	 {
+		free (pool->queue);
+		free (pool->thread);
+		free (pool->worker);
+		free (pool);
+		return (NULL);
+	 }
+   pthread_mutex_init (&pool->lock,NULL);
+   pthread_cond_init (&pool->work,NULL);
+   pthread_cond_init (&pool->done,NULL);
+   for (i = 0; i < threads; i++) pthread_mutex_init (&pool->queue[i].lock,NULL);
+   for (i = 1; i < threads; i++)
+	 {
+		pool->worker[i].pool = pool;
+		pool->worker[i].index = i;
+		if (pthread_create (&pool->thread[i],NULL,work,&pool->worker[i]) != 0)
+		  {
+			 /* Make do with the ones we have */
+			 pool->numthreads = i;
+			 break;
+		  }
+	 }
+   return (pool);
+}
+
+/* Stop the threads and free the pool */
+void pool_free (pool_t *pool)
+{
+   int i;
+   pthread_mutex_lock (&pool->lock);
+   pool->quit = TRUE;
+   pthread_cond_broadcast (&pool->work);
+   pthread_mutex_unlock (&pool->lock);
+   for (i = 1; i < pool->numthreads; i++) pthread_join (pool->thread[i],NULL);
+   for (i = 0; i < pool->numthreads; i++) free (pool->queue[i].jobs);
+   free (pool->queue);
+   free (pool->thread);
+   free (pool->worker);
+   free (pool);
+}
+
+/* Let a thread from outside run jobs as thread 0, if no other one does */
+/* already. Returns TRUE if it got to */
+static bool enlist (pool_t *pool)
+{
+   bool helping = FALSE;
+   pthread_mutex_lock (&pool->lock);
+   if (self < 0 && !pool->helped) pool->helped = helping = TRUE;
+   pthread_mutex_unlock (&pool->lock);
+   if (helping) self = 0;
+   return (helping);
+}
+
+/* Queue a job */
+void pool_submit (pool_t *pool,task_t task,void *arg)
+{
+   job_t job;
+   int index;
+   bool helping;
+   job.task = task;
+   job.arg = arg;
+   pthread_mutex_lock (&pool->lock);
+   /* Jobs from outside are spread over the queues, jobs from a job stay with its thread */
+   index = self < 0 ? pool->next++ % pool->numthreads : self;
+   pool->pending++;
+   /* Counted before it's pushed, so taking it can't make the count negative */
+   pool->queued++;
+   pthread_mutex_unlock (&pool->lock);
+   /* Run it here and now if there's no room, as thread 0 if we're from outside */
+   if (!push (&pool->queue[index],&job))
+	 {
+		pthread_mutex_lock (&pool->lock);
+		pool->queued--;
+		pthread_mutex_unlock (&pool->lock);
+		helping = enlist (pool);
+		run (pool,&job);
+		if (helping)
+		  {
+			 pthread_mutex_lock (&pool->lock);
+			 pool->helped = FALSE;
+			 pthread_mutex_unlock (&pool->lock);
+			 self = -1;
+		  }
+		return;
+	 }
+   pthread_mutex_lock (&pool->lock);
+   pthread_cond_signal (&pool->work);
+   pthread_mutex_unlock (&pool->lock);
+}
+
+/* Help with the jobs until all of them are done */
+void pool_wait (pool_t *pool)
+{
+   job_t job;
+   /* Only one thread from outside runs jobs at a time, so thread numbers stay unique */
+   bool helping = enlist (pool);
+   for (;;)
+	 {
+		if (self >= 0 && take (pool,self,&job))
+		  {
+			 run (pool,&job);
+			 continue;
+		  }
+		pthread_mutex_lock (&pool->lock);
+		if (self < 0 || !pool->queued)
+		  {
+			 while (pool->pending) pthread_cond_wait (&pool->done,&pool->lock);
+			 if (helping)
+			   {
+				  pool->helped = FALSE;
+				  self = -1;
+			   }
+			 pthread_mutex_unlock (&pool->lock);
+			 return;
+		  }
+		pthread_mutex_unlock (&pool->lock);
+	 }
+}
+
+/* Number of threads in the pool */
+int pool_threads (const pool_t *pool)
+{
+   return (pool->numthreads);
+}
+
+/* Number of the thread running the current job */
+int pool_worker ()
+{
+   return (self);
+}
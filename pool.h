@@ -0,0 +1,88 @@
+#ifndef POOL_H
+#define POOL_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A work-stealing thread pool for coarse jobs, like playing a game.
+ * Every thread has its own queue and takes its newest job first; a
+ * thread that runs out steals the oldest job of another, so threads
+ * stay busy when jobs take wildly different times.
+ */
+
+/*
+ * Type definitions
+ */
+
+typedef void (*task_t) (void *arg);
+
+typedef struct pool_struct pool_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Create a pool of threads. The thread calling pool_wait () is one of
+ * them, so threads - 1 are started. Returns NULL if something fails
+ */
+pool_t *pool_new (int threads);
+
+/*
+ * Stop the threads and free the pool. There may not be any jobs left
+ */
+void pool_free (pool_t *pool);
+
+/*
+ * Queue a job. Jobs may queue more jobs. If there's no memory to queue
+ * it, the job is run straight away, as thread 0 when called from outside
+ * the pool (unless another thread from outside is helping)
+ */
+void pool_submit (pool_t *pool,task_t task,void *arg);
+
+/*
+ * Help with the jobs until all of them are done. Only one thread from
+ * outside the pool helps at a time; any other just waits
+ */
+void pool_wait (pool_t *pool);
+
+/*
+ * Number of threads in the pool
+ */
+int pool_threads (const pool_t *pool);
+
+/*
+ * Number of the thread running the current job, from 0 up to the number
+ * of threads in the pool, or -1 outside a job (in a thread that isn't
+ * the pool's). A job only sees -1 when two threads from outside use the
+ * pool at once (see pool_submit ()). Handy for per-thread scratch space
+ */
+int pool_worker ();
+
+#endif	/* #ifndef POOL_H */
@@ -0,0 +1,237 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Profiling zones. Every thread gets its own table of totals, so
+ * zones never contend; the tables are chained together and summed
+ * at exit. Cycles come from the time stamp counter. Instructions,
+ * cache misses and branch misses come from a perf_event_open () group
+ * per thread when the kernel allows it, and are left out otherwise.
+ */
+
+#ifdef PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "typedefs.h"
+#include "profile.h"
+
+/*
+ * Type definitions
+ */
+
+typedef struct
+{
+   uint64_t calls;
+   uint64_t cycles;
+   uint64_t max;
+   uint64_t counters[NUMCOUNTERS];
+} zonestats_t;
+
+typedef struct table_struct
+{
+   zonestats_t zone[NUMZONES];
+   int group;						/* perf group leader, -1 if none */
+   int numcounters;					/* counters in the group */
+   int counter[NUMCOUNTERS];		/* which counter each group member is */
+   struct table_struct *next;
+} table_t;
+
+/*
+ * Global variables
+ */
+
+static const char *zonename[NUMZONES] =
+{
+   "engine_evaluate",
+   "engine_move",
+   "droplines",
+   "place_shadow_to_bottom",
+   "drawboard",
+   "showstatus",
+   "out_refresh",
+   "in_getch"
+};
+
+static const struct
+{
+   const char *name;
+   uint64_t config;
+} counter[NUMCOUNTERS] =
+{
+   { "instr", PERF_COUNT_HW_INSTRUCTIONS },
+   { "cache-miss", PERF_COUNT_HW_CACHE_MISSES },
+   { "branch-miss", PERF_COUNT_HW_BRANCH_MISSES }
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* All the tables, for the report */
+static table_t *tables;
+
+/* This thread's table */
+static __thread table_t *table;
+
+/*
+ * Functions
+ */
+
+/* Read the cycle counter (nanoseconds where there isn't one) */
+static inline uint64_t cycles ()
+{
+#if defined(__x86_64__) || defined(__i386__)
+   return (__rdtsc ());
+#else
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC,&ts);
+   return ((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+/* Open one hardware counter in this thread's group */
+static int opencounter (uint64_t config,int group)
+{
+   struct perf_event_attr attr;
+   memset (&attr,0,sizeof (attr));
+   attr.size = sizeof (attr);
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.config = config;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_GROUP;
+   return (syscall (SYS_perf_event_open,&attr,0,-1,group,0));
+}
+
+/* Read the counters of this thread's group into values. Returns FALSE if there are none */
+static bool readcounters (uint64_t *values)
+{
+   uint64_t buf[1 + NUMCOUNTERS];
+   int i;
+   if (table->group < 0 || read (table->group,buf,sizeof (buf)) < (ssize_t) ((1 + table->numcounters) * sizeof (uint64_t))) return FALSE;
+   for (i = 0; i < table->numcounters; i++) values[table->counter[i]] = buf[1 + i];
+   return TRUE;
+}
+
+/* Print the totals of all threads */
+static void report ()
+{
+   zonestats_t total;
+   const table_t *t;
+   bool counters = FALSE;
+   int i,j;
+   for (t = tables; t != NULL; t = t->next) if (t->group >= 0) counters = TRUE;
+   fprintf (stderr,"\n%-24s %10s %14s %10s %10s",
+#if defined(__x86_64__) || defined(__i386__)
+			"zone","calls","cycles","avg","max"
+#else
+			"zone","calls","ns","avg","max"
+#endif
+			);
+   if (counters) for (j = 0; j < NUMCOUNTERS; j++) fprintf (stderr," %12s",counter[j].name);
+   fprintf (stderr,"\n");
+   for (i = 0; i < NUMZONES; i++)
+	 {
+		memset (&total,0,sizeof (total));
+		for (t = tables; t != NULL; t = t->next)
+		  {
+			 total.calls += t->zone[i].calls;
+			 total.cycles += t->zone[i].cycles;
+			 if (t->zone[i].max > total.max) total.max = t->zone[i].max;
+			 for (j = 0; j < NUMCOUNTERS; j++) total.counters[j] += t->zone[i].counters[j];
+		  }
+		if (!total.calls) continue;
+		fprintf (stderr,"%-24s %10llu %14llu %10llu %10llu",zonename[i],
+				 (unsigned long long) total.calls,(unsigned long long) total.cycles,
+				 (unsigned long long) (total.cycles / total.calls),(unsigned long long) total.max);
+		/* Counters are per call */
+		if (counters) for (j = 0; j < NUMCOUNTERS; j++) fprintf (stderr," %12.1f",(double) total.counters[j] / total.calls);
+		fprintf (stderr,"\n");
+	 }
+}
+
+/* Give this thread a table, and open its counters */
+static void newtable ()
+{
+   int i,fd;
+   if ((table = calloc (1,sizeof (table_t))) == NULL)
+	 {
+		perror ("calloc");
+		exit (EXIT_FAILURE);
+	 }
+   table->group = -1;
+   for (i = 0; i < NUMCOUNTERS; i++)
+	 if ((fd = opencounter (counter[i].config,table->group)) >= 0)
+	   {
+		  if (table->group < 0) table->group = fd;
+		  table->counter[table->numcounters++] = i;
+	   }
+   pthread_mutex_lock (&lock);
+   if (tables == NULL) atexit (report);
+   table->next = tables;
+   tables = table;
+   pthread_mutex_unlock (&lock);
+}
+
+/* Start timing a zone */
+scope_t profile_enter (zone_t zone)
+{
+   scope_t scope;
+   if (table == NULL) newtable ();
+   scope.zone = zone;
+   memset (scope.counters,0,sizeof (scope.counters));
+   readcounters (scope.counters);
+   scope.start = cycles ();
+   return (scope);
+}
+
+/* Stop timing a zone */
+void profile_leave (scope_t *scope)
+{
+   uint64_t now = cycles (),values[NUMCOUNTERS] = { 0 };
+   zonestats_t *stats = &table->zone[scope->zone];
+   int i;
+   stats->calls++;
+   stats->cycles += now - scope->start;
+   if (now - scope->start > stats->max) stats->max = now - scope->start;
+   if (readcounters (values))
+	 for (i = 0; i < NUMCOUNTERS; i++) stats->counters[i] += values[i] - scope->counters[i];
+}
+
+#endif	/* #ifdef PROFILE */
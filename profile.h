@@ -0,0 +1,98 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Timing zones for the hot paths. Build with -DPROFILE (make PROFILE=1)
+ * and a table of calls, cycles and hardware counters per zone is printed
+ * to stderr at exit. Without it PROFILE_ZONE () compiles to nothing.
+ *
+ * A zone covers everything from PROFILE_ZONE () to the end of the
+ * enclosing block, including zones nested inside it.
+ */
+
+/*
+ * Type definitions
+ */
+
+typedef enum
+{
+   ZONE_ENGINE_EVALUATE,
+   ZONE_ENGINE_MOVE,
+   ZONE_DROPLINES,
+   ZONE_SHADOW,
+   ZONE_DRAWBOARD,
+   ZONE_SHOWSTATUS,
+   ZONE_REFRESH,
+   ZONE_GETCH,
+   NUMZONES
+} zone_t;
+
+#ifdef PROFILE
+
+#include <stdint.h>			/* uint64_t */
+
+/* Hardware counters read with perf_event_open () */
+#define NUMCOUNTERS 3
+
+typedef struct
+{
+   zone_t zone;
+   uint64_t start;
+   uint64_t counters[NUMCOUNTERS];
+} scope_t;
+
+/*
+ * Macros
+ */
+
+#define PROFILE_ZONE(zone) scope_t profile_scope __attribute__ ((cleanup (profile_leave))) = profile_enter (zone)
+
+/*
+ * Functions
+ */
+
+/*
+ * Start timing a zone. Use PROFILE_ZONE () instead
+ */
+scope_t profile_enter (zone_t zone);
+
+/*
+ * Stop timing a zone. Called when the scope ends
+ */
+void profile_leave (scope_t *scope);
+
+#else	/* #ifdef PROFILE */
+
+#define PROFILE_ZONE(zone)
+
+#endif	/* #ifdef PROFILE */
+
+#endif	/* #ifndef PROFILE_H */
@@ -0,0 +1,158 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Recording and playing back games. The file is text: a header line
+ *
+ *   tint-replay 1 seed level shownext dottedlines shadow practice
+ *
+ * then a line with the tick and the key for every key handled, and a
+ * last line with the tick the game stopped in, the score and the hash
+ *
+ *   tick end score hash
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "typedefs.h"
+#include "game.h"
+#include "history.h"
+#include "replay.h"
+
+/*
+ * Macros
+ */
+
+/* First word of a recorded game, and the version of the format */
+#define MAGIC "tint-replay"
+#define VERSION 1
+
+/* Longest line we expect */
+#define LINESIZE 128
+
+/*
+ * Global variables
+ */
+
+/* The game being recorded or played back */
+static FILE *file = NULL;
+
+/* How the recorded game stopped, once we got to the end of the file */
+static bool ended = FALSE;
+static unsigned long last;
+static int score;
+static uint64_t hash;
+
+/*
+ * Functions
+ */
+
+/* Start recording the game in a file */
+bool replay_record (const char *filename,const game_t *game)
+{
+   if ((file = fopen (filename,"w")) == NULL) return (FALSE);
+   fprintf (file,"%s %d %u %d %d %d %d %d\n",MAGIC,VERSION,game->seed,game->level,
+			game->shownext,game->dottedlines,game->shadow,game->history != NULL);
+   return (TRUE);
+}
+
+/* Record a key, handled in the given tick */
+void replay_key (unsigned long tick,int key)
+{
+   if (file != NULL) fprintf (file,"%lu %d\n",tick,key);
+}
+
+/* Record how the game stopped and close the file */
+void replay_stop (const game_t *game)
+{
+   if (file == NULL) return;
+   fprintf (file,"%lu end %d %016" PRIx64 "\n",game->tick,game->engine.score,game->engine.hash);
+   fclose (file);
+   file = NULL;
+}
+
+/* Start playing back the game recorded in a file */
+bool replay_load (const char *filename,game_t *game)
+{
+   char magic[LINESIZE],line[LINESIZE];
+   int version,level,shownext,dottedlines,shadow,practice;
+   unsigned int seed;
+   if ((file = fopen (filename,"r")) == NULL) return (FALSE);
+   if (fgets (line,sizeof (line),file) == NULL ||
+	   sscanf (line,"%127s %d %u %d %d %d %d %d",magic,&version,&seed,&level,&shownext,&dottedlines,&shadow,&practice) != 8 ||
+	   strcmp (magic,MAGIC) != 0 || version != VERSION || level < MINLEVEL || level > MAXLEVEL ||
+	   /* Taking back shapes is a key like any other, so it has to work the same */
+	   (practice && game->history == NULL && (game->history = history_new ()) == NULL))
+	 {
+		fclose (file);
+		file = NULL;
+		return (FALSE);
+	 }
+   game_reseed (game,seed);
+   game->level = level;
+   game->shownext = shownext;
+   game->dottedlines = dottedlines;
+   game->shadow = shadow;
+   if (!practice && game->history != NULL)
+	 {
+		history_free (game->history);
+		game->history = NULL;
+	 }
+   return (TRUE);
+}
+
+/* The next recorded key and the tick to handle it in */
+bool replay_next (unsigned long *tick,int *key)
+{
+   char line[LINESIZE];
+   if (file == NULL) return (FALSE);
+   while (fgets (line,sizeof (line),file) != NULL)
+	 {
+		if (sscanf (line,"%lu end %d %" SCNx64,tick,&score,&hash) == 3)
+		  {
+			 ended = TRUE;
+			 last = *tick;
+			 break;
+		  }
+		if (sscanf (line,"%lu %d",tick,key) == 2) return (TRUE);
+	 }
+   fclose (file);
+   file = NULL;
+   return (FALSE);
+}
+
+/* Whether the game came out the way it did when it was recorded */
+bool replay_matches (const game_t *game)
+{
+   return (ended && game->tick == last && game->engine.score == score && game->engine.hash == hash);
+}
@@ -0,0 +1,87 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "typedefs.h"		/* bool */
+#include "game.h"			/* game_t */
+
+/*
+ * A recorded game is the seed and the options it started with, then
+ * every key handled, with the tick it was handled in. Playing the keys
+ * back in the same ticks plays the same game. It ends with the tick the
+ * game stopped in, the score and the hash of the position, so the
+ * playback can tell whether it came out the same
+ */
+
+/*
+ * Functions
+ */
+
+/*
+ * Start recording the game in a file. Must be called after the options
+ * have been set and before the first key. Returns FALSE if the file
+ * couldn't be created
+ */
+bool replay_record (const char *filename,const game_t *game);
+
+/*
+ * Record a key, handled in the given tick. Does nothing if no game is
+ * being recorded
+ */
+void replay_key (unsigned long tick,int key);
+
+/*
+ * Record how the game stopped and close the file
+ */
+void replay_stop (const game_t *game);
+
+/*
+ * Start playing back the game recorded in a file. The game must have
+ * been initialized with game_init (); its seed and the options that
+ * change how it goes are replaced with the recorded ones. Returns FALSE
+ * if the file can't be read or isn't a recorded game
+ */
+bool replay_load (const char *filename,game_t *game);
+
+/*
+ * The next recorded key and the tick to handle it in. Returns FALSE
+ * once there are no more; tick is then the one the game stopped in
+ */
+bool replay_next (unsigned long *tick,int *key);
+
+/*
+ * Whether the game came out the way it did when it was recorded. Only
+ * makes sense once replay_next () returned FALSE and the game got to
+ * the last tick
+ */
+bool replay_matches (const game_t *game);
+
+#endif	/* #ifndef REPLAY_H */
@@ -0,0 +1,233 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Monte-Carlo placement. Every placement of the current shape is
+ * followed by a number of continuations, each with a different future
+ * that the bag allows, played by the AI without looking ahead (or at
+ * random). A placement is worth the lines its continuations make plus
+ * what the AI thinks of where they end up, averaged. The continuations
+ * are jobs in a work-stealing pool; every thread plays them in its own
+ * engine, AI and random number generator, allocated once in a single
+ * arena, so jobs never allocate or share anything.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "ai.h"
+#include "pool.h"
+#include "rollout.h"
+
+/*
+ * Macros
+ */
+
+/* What losing the game costs, in the units of the AI's evaluation */
+#define PENALTY 1000.0
+
+/* Keeps threads' scratch space apart in the cache */
+#define CACHELINE 64
+
+/*
+ * Type definitions
+ */
+
+/* What a thread plays with */
+typedef struct
+{
+   engine_t engine;
+   ai_t *ai;
+   uint64_t rng;
+} __attribute__ ((aligned (CACHELINE))) scratch_t;
+
+/* One continuation (a job in the pool) */
+typedef struct
+{
+   rollout_t *rollout;
+   int move;						/* placement it follows */
+   unsigned int seed;
+   double value;
+   bool done;
+} sample_t;
+
+struct rollout_struct
+{
+   pool_t *pool;
+   int rollouts,horizon;
+   bool greedy;
+   scratch_t *scratch;				/* one per thread, and one for threads outside the pool */
+   sample_t *samples;
+   const engine_t *root;
+   ai_move_t moves[AI_MAXMOVES];
+   long long deadline;				/* 0 if there's no hurry */
+   unsigned int decisions;			/* for seeding the samples */
+};
+
+/*
+ * Functions
+ */
+
+/* Rollouts keep the score to themselves */
+static void score_function (engine_t *engine)
+{
+}
+
+/* Scratch space of the thread we're running in */
+static scratch_t *myscratch (rollout_t *rollout)
+{
+   int worker = pool_worker ();
+   return (&rollout->scratch[worker < 0 ? pool_threads (rollout->pool) : worker]);
+}
+
+/* Play one continuation */
+static void simulate (void *arg)
+{
+   sample_t *sample = arg;
+   rollout_t *rollout = sample->rollout;
+   scratch_t *scratch = myscratch (rollout);
+   engine_t *engine = &scratch->engine;
+   ai_move_t moves[AI_MAXMOVES];
+   int i,j,n,t,lines,result;
+   if (rollout->deadline && microseconds () > rollout->deadline) return;
+   memcpy (engine,rollout->root,sizeof (engine_t));
+   engine->score_function = score_function;
+   engine->data = NULL;
+   /* A future the bag allows: the rest of this bag in any order, then anything */
+   scratch->rng = sample->seed;
+   for (i = engine->bag_iterator % NUMSHAPES + 1; i < NUMSHAPES - 1; i++)
+	 {
+		j = i + rand_next (&scratch->rng,NUMSHAPES - i);
+		t = engine->bag[i];
+		engine->bag[i] = engine->bag[j];
+		engine->bag[j] = t;
+	 }
+   engine->rng = scratch->rng;
+   lines = engine->status.droppedlines;
+   result = ai_apply (engine,&rollout->moves[sample->move]);
+   for (i = 0; i < rollout->horizon && result >= 0; i++)
+	 if (rollout->greedy)
+	   result = ai_play (scratch->ai,engine,0,1);
+	 else if ((n = ai_placements (scratch->ai,engine,moves)) > 0)
+	   result = ai_apply (engine,&moves[rand_next (&scratch->rng,n)]);
+	 else result = -1;
+   sample->value = result < 0 ? -PENALTY :
+	 AI_WEIGHTS.weight[FEATURE_LINES] * (engine->status.droppedlines - lines) + ai_evaluate (scratch->ai,engine);
+   sample->done = TRUE;
+}
+
+/* Create a chooser */
+rollout_t *rollout_new (pool_t *pool,int rollouts,int horizon,bool greedy)
+{
+   rollout_t *rollout;
+   int i,threads = pool_threads (pool) + 1;
+   if ((rollout = calloc (1,sizeof (rollout_t))) == NULL) return (NULL);
+   rollout->pool = pool;
+   rollout->rollouts = rollouts;
+   rollout->horizon = horizon;
+   rollout->greedy = greedy;
+   if ((rollout->samples = calloc (AI_MAXMOVES * rollouts,sizeof (sample_t))) == NULL ||
+	   (rollout->scratch = aligned_alloc (CACHELINE,threads * sizeof (scratch_t))) == NULL)
+	 {
+		free (rollout->samples);
+		free (rollout);
+		return (NULL);
+	 }
+   for (i = 0; i < threads; i++)
+	 if ((rollout->scratch[i].ai = ai_new (&AI_WEIGHTS)) == NULL)
+	   {
+		  while (i--) ai_free (rollout->scratch[i].ai);
+		  free (rollout->scratch);
+		  free (rollout->samples);
+		  free (rollout);
+		  return (NULL);
+	   }
+   return (rollout);
+}
+
+/* Free a chooser */
+void rollout_free (rollout_t *rollout)
+{
+   int i;
+   for (i = 0; i <= pool_threads (rollout->pool); i++) ai_free (rollout->scratch[i].ai);
+   free (rollout->scratch);
+   free (rollout->samples);
+   free (rollout);
+}
+
+/* Choose a placement by playing on from each of them */
+bool rollout_choose (rollout_t *rollout,const engine_t *engine,long budget,ai_move_t *move)
+{
+   sample_t *sample;
+   double value,best = 0;
+   int i,k,n,count,chosen = -1;
+   if (!(n = ai_placements (myscratch (rollout)->ai,engine,rollout->moves))) return (FALSE);
+   rollout->root = engine;
+   rollout->deadline = budget ? microseconds () + budget : 0;
+   rollout->decisions++;
+   /* The same seeds for every placement, so they're compared on the same futures */
+   for (k = 0; k < rollout->rollouts; k++)
+	 for (i = 0; i < n; i++)
+	   {
+		  sample = &rollout->samples[k * n + i];
+		  sample->rollout = rollout;
+		  sample->move = i;
+		  sample->seed = rollout->decisions * 2654435761u + k;
+		  sample->done = FALSE;
+		  pool_submit (rollout->pool,simulate,sample);
+	   }
+   pool_wait (rollout->pool);
+   for (i = 0; i < n; i++)
+	 {
+		for (value = 0, count = 0, k = 0; k < rollout->rollouts; k++)
+		  if (rollout->samples[k * n + i].done)
+			{
+			   value += rollout->samples[k * n + i].value;
+			   count++;
+			}
+		/* Placements without results can't be judged */
+		if (!count) continue;
+		/* Ties go to the one the AI likes best by itself */
+		value = value / count + rollout->moves[i].value * 1e-6;
+		if (chosen < 0 || value > best) best = value, chosen = i;
+	 }
+   /* Out of time before anything was played: do what the AI does without looking ahead */
+   if (chosen < 0)
+	 for (i = 0; i < n; i++)
+	   if (chosen < 0 || rollout->moves[i].value > best) best = rollout->moves[i].value, chosen = i;
+   *move = rollout->moves[chosen];
+   move->depth = 1 + rollout->horizon;
+   move->value = best;
+   return (TRUE);
+}
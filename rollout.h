@@ -0,0 +1,77 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* engine_t */
+#include "ai.h"				/* ai_move_t */
+#include "pool.h"			/* pool_t */
+
+/*
+ * Macros
+ */
+
+/* Continuations played for every placement */
+#define ROLLOUTS 16
+
+/* Shapes played in each of them */
+#define HORIZON 8
+
+/*
+ * Type definitions
+ */
+
+typedef struct rollout_struct rollout_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Create a chooser that plays rollouts continuations of horizon shapes
+ * in the threads of pool, with the AI (greedy) or at random. Returns
+ * NULL if we run out of memory
+ */
+rollout_t *rollout_new (pool_t *pool,int rollouts,int horizon,bool greedy);
+
+/*
+ * Free a chooser (but not its pool)
+ */
+void rollout_free (rollout_t *rollout);
+
+/*
+ * Choose a placement for the current shape of engine by playing on
+ * from every placement and averaging how that goes. Rollouts still to
+ * be played after budget microseconds (0 for no limit) are skipped.
+ * Returns FALSE if the shape can't be placed
+ */
+bool rollout_choose (rollout_t *rollout,const engine_t *engine,long budget,ai_move_t *move);
+
+#endif	/* #ifndef ROLLOUT_H */
@@ -0,0 +1,726 @@
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pwd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "typedefs.h"
+#include "config.h"
+#include "scores.h"
+
+/*
+ * Macros
+ */
+
+/* Magic number and version at the start of the score file */
+#define SCOREDB_MAGIC	"TINTSCDB"
+#define SCOREDB_VERSION	1
+
+/* Sizes of the header, a record and an index entry */
+#define HEADERSIZE	16
+#define RECORDSIZE	32
+#define INDEXSIZE	4
+
+/* Offsets of the fields in the header and in a record */
+#define HDR_VERSION	8
+#define HDR_COUNT	12
+#define REC_NAME	0
+#define REC_SCORE	NAMELEN
+#define REC_TIME	(NAMELEN + 4)
+
+/* Size of the score file with n records */
+#define DBSIZE(n) (HEADERSIZE + (size_t) (n) * (RECORDSIZE + INDEXSIZE))
+
+/* Address of record i and of name index entry i */
+#define RECORD(db,i) ((db)->image + HEADERSIZE + (size_t) (i) * RECORDSIZE)
+#define INDEX(db,i) ((db)->image + HEADERSIZE + (size_t) scoredb_count (db) * RECORDSIZE + (size_t) (i) * INDEXSIZE)
+
+/* Header of the score file used up to tint 0.04. Scores used to be stored */
+/* as a name, a native int and a native time_t */
+#define OLD_HEADER	"Tint 0.02b (c) Abraham vd Merwe - Scores"
+#define OLD_NUMSCORES	10
+
+/* Permissions of the score file */
+#define SCOREFILEMODE 0664
+
+/* Number of times we try to lock the score file, and microseconds to wait between tries */
+#define LOCKTRIES 100
+#define LOCKWAIT 10000
+
+/* Milliseconds we wait for the score daemon to answer */
+#define SCORED_TIMEOUT 2000
+
+/* Size of the buffer for replies from the score daemon */
+#define SCORED_REPLYSIZE 4096
+
+/* Header for score title */
+static const char scoretitle[] = "\n\t   TINT HIGH SCORES\n\n\tRank   Score        Name\n\n";
+
+/*
+ * Encoding
+ */
+
+static uint32_t get32 (const unsigned char *p)
+{
+   return ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+}
+
+static void put32 (unsigned char *p,uint32_t value)
+{
+   p[0] = value;
+   p[1] = value >> 8;
+   p[2] = value >> 16;
+   p[3] = value >> 24;
+}
+
+static uint64_t get64 (const unsigned char *p)
+{
+   return ((uint64_t) get32 (p + 4) << 32 | get32 (p));
+}
+
+static void put64 (unsigned char *p,uint64_t value)
+{
+   put32 (p,value);
+   put32 (p + 4,value >> 32);
+}
+
+static int getscore (const scoredb_t *db,int rank)
+{
+   return ((int32_t) get32 (RECORD (db,rank) + REC_SCORE));
+}
+
+/* Compare the name in the given record with name */
+static int cmpname (const scoredb_t *db,uint32_t rank,const char *name)
+{
+   return (strncmp ((const char *) RECORD (db,rank) + REC_NAME,name,NAMELEN));
+}
+
+/*
+ * Score table
+ */
+
+/* Start with an empty table in memory */
+static bool emptydb (scoredb_t *db)
+{
+   if ((db->image = malloc (HEADERSIZE)) == NULL) return FALSE;
+   memcpy (db->image,SCOREDB_MAGIC,8);
+   put32 (db->image + HDR_VERSION,SCOREDB_VERSION);
+   put32 (db->image + HDR_COUNT,0);
+   db->size = HEADERSIZE;
+   db->mapped = FALSE;
+   return TRUE;
+}
+
+/* Make sure the table is in memory we own, so it can be changed */
+static bool privatedb (scoredb_t *db)
+{
+   unsigned char *image;
+   if (!db->mapped) return TRUE;
+   if ((image = malloc (db->size)) == NULL) return FALSE;
+   memcpy (image,db->image,db->size);
+   munmap (db->image,db->size);
+   db->image = image;
+   db->mapped = FALSE;
+   return TRUE;
+}
+
+/* Parse a table in the old format with the given size of time_t */
+static bool migratedb (scoredb_t *db,const unsigned char *buf,size_t len,size_t timesize)
+{
+   score_t score;
+   size_t ofs = strlen (OLD_HEADER),n;
+   int i;
+   int32_t value;
+   if (!emptydb (db)) return FALSE;
+   for (i = 0; i < OLD_NUMSCORES; i++)
+	 {
+		n = strnlen ((const char *) buf + ofs,len - ofs);
+		if (n >= NAMELEN - 1 || ofs + n + 1 + sizeof (value) + timesize > len) break;
+		memset (score.name,0,NAMELEN);
+		memcpy (score.name,buf + ofs,n);
+		ofs += n + 1;
+		memcpy (&value,buf + ofs,sizeof (value));
+		ofs += sizeof (value);
+		if (timesize == sizeof (int64_t))
+		  {
+			 int64_t timestamp;
+			 memcpy (&timestamp,buf + ofs,timesize);
+			 score.timestamp = timestamp;
+		  }
+		else
+		  {
+			 int32_t timestamp;
+			 memcpy (&timestamp,buf + ofs,timesize);
+			 score.timestamp = timestamp;
+		  }
+		ofs += timesize;
+		score.score = value;
+		/* Unused entries have a score of -1 */
+		if (score.score >= 0 && scoredb_add (db,&score) < 0) break;
+	 }
+   if (i == OLD_NUMSCORES && ofs == len) return TRUE;
+   scoredb_free (db);
+   return FALSE;
+}
+
+/*
+ * Load the score table from an open score file. An empty file gives an
+ * empty table and files in the old format are converted. Returns FALSE
+ * if the file is corrupt.
+ */
+bool scoredb_load (scoredb_t *db,int fd)
+{
+   struct stat st;
+   unsigned char *map;
+   size_t count,i;
+   if (fstat (fd,&st) < 0) return FALSE;
+   if (st.st_size == 0) return emptydb (db);
+   map = mmap (NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+   if (map == MAP_FAILED) return FALSE;
+   if ((size_t) st.st_size >= HEADERSIZE && memcmp (map,SCOREDB_MAGIC,8) == 0)
+	 {
+		db->image = map;
+		db->size = st.st_size;
+		db->mapped = TRUE;
+		count = get32 (map + HDR_COUNT);
+		if (get32 (map + HDR_VERSION) == SCOREDB_VERSION && count <= MAXSCORES && db->size == DBSIZE (count))
+		  {
+			 for (i = 0; i < count; i++) if (get32 (INDEX (db,i)) >= count) break;
+			 if (i == count) return TRUE;
+		  }
+		scoredb_free (db);
+		return FALSE;
+	 }
+   /* Old (native) format. We don't know the size of time_t it was written with */
+   if ((size_t) st.st_size > strlen (OLD_HEADER) && memcmp (map,OLD_HEADER,strlen (OLD_HEADER)) == 0 &&
+	   (migratedb (db,map,st.st_size,sizeof (int64_t)) || migratedb (db,map,st.st_size,sizeof (int32_t))))
+	 {
+		munmap (map,st.st_size);
+		return TRUE;
+	 }
+   munmap (map,st.st_size);
+   return FALSE;
+}
+
+/*
+ * Release the score table
+ */
+void scoredb_free (scoredb_t *db)
+{
+   if (db->mapped) munmap (db->image,db->size); else free (db->image);
+   db->image = NULL;
+   db->size = 0;
+}
+
+/*
+ * Number of scores in the table
+ */
+int scoredb_count (const scoredb_t *db)
+{
+   return (get32 (db->image + HDR_COUNT));
+}
+
+/*
+ * Get the score at the given rank (0 is the best)
+ */
+void scoredb_get (const scoredb_t *db,int rank,score_t *score)
+{
+   const unsigned char *record = RECORD (db,rank);
+   memcpy (score->name,record + REC_NAME,NAMELEN);
+   score->name[NAMELEN - 1] = '\0';
+   score->score = getscore (db,rank);
+   score->timestamp = (int64_t) get64 (record + REC_TIME);
+}
+
+/*
+ * Rank of the best score of the specified player, -1 if there is none
+ */
+int scoredb_best (const scoredb_t *db,const char *name)
+{
+   int lo = 0,hi = scoredb_count (db),mid;
+   /* Entries for the same name are sorted by rank, so we want the first one */
+   while (lo < hi)
+	 {
+		mid = (lo + hi) / 2;
+		if (cmpname (db,get32 (INDEX (db,mid)),name) < 0) lo = mid + 1; else hi = mid;
+	 }
+   if (lo < scoredb_count (db) && cmpname (db,get32 (INDEX (db,lo)),name) == 0) return (get32 (INDEX (db,lo)));
+   return (-1);
+}
+
+/*
+ * Rank a new score would get. Returns MAXSCORES if it won't make it into the table
+ */
+int scoredb_rank (const scoredb_t *db,int score)
+{
+   int lo = 0,hi = scoredb_count (db),mid;
+   /* New scores go after older scores that are just as good */
+   while (lo < hi)
+	 {
+		mid = (lo + hi) / 2;
+		if (getscore (db,mid) >= score) lo = mid + 1; else hi = mid;
+	 }
+   return (lo < MAXSCORES ? lo : MAXSCORES);
+}
+
+/*
+ * Rank of the given score if it is in the table, -1 otherwise
+ */
+int scoredb_find (const scoredb_t *db,const score_t *score)
+{
+   score_t entry;
+   int rank = scoredb_rank (db,score->score);
+   /* The rank is just past all scores that are as good */
+   while (--rank >= 0 && getscore (db,rank) == score->score)
+	 {
+		scoredb_get (db,rank,&entry);
+		if (entry.timestamp == score->timestamp && strcmp (entry.name,score->name) == 0) return (rank);
+	 }
+   return (-1);
+}
+
+/* Remove the worst score from a (private) table */
+static void droplast (scoredb_t *db)
+{
+   uint32_t count = scoredb_count (db),i;
+   unsigned char *index = INDEX (db,0);
+   for (i = 0; get32 (index + i * INDEXSIZE) != count - 1; i++) ;
+   memmove (index + i * INDEXSIZE,index + (i + 1) * INDEXSIZE,(count - 1 - i) * INDEXSIZE);
+   memmove (index - RECORDSIZE,index,(count - 1) * INDEXSIZE);
+   put32 (db->image + HDR_COUNT,count - 1);
+   db->size = DBSIZE (count - 1);
+}
+
+/*
+ * Add a score to the table. Returns its rank or -1 if it didn't make it
+ * into the table (or we ran out of memory).
+ */
+int scoredb_add (scoredb_t *db,const score_t *score)
+{
+   uint32_t count,rank,i,pos,lo,hi,rec;
+   unsigned char *image,*record,*index;
+   int cmp;
+   if ((rank = scoredb_rank (db,score->score)) >= MAXSCORES || !privatedb (db)) return (-1);
+   if (scoredb_count (db) == MAXSCORES) droplast (db);
+   count = scoredb_count (db);
+   if ((image = realloc (db->image,DBSIZE (count + 1))) == NULL) return (-1);
+   db->image = image;
+   db->size = DBSIZE (count + 1);
+   /* Make room for the new record */
+   index = INDEX (db,0);
+   memmove (index + RECORDSIZE,index,count * INDEXSIZE);
+   record = RECORD (db,rank);
+   memmove (record + RECORDSIZE,record,(count - rank) * RECORDSIZE);
+   memset (record,0,RECORDSIZE);
+   strncpy ((char *) record + REC_NAME,score->name,NAMELEN - 1);
+   put32 (record + REC_SCORE,score->score);
+   put64 (record + REC_TIME,(int64_t) score->timestamp);
+   put32 (image + HDR_COUNT,count + 1);
+   /* Renumber the index and insert the new record after all others with the same name */
+   index = INDEX (db,0);
+   for (i = 0; i < count; i++)
+	 if ((rec = get32 (index + i * INDEXSIZE)) >= rank) put32 (index + i * INDEXSIZE,rec + 1);
+   lo = 0;
+   hi = count;
+   while (lo < hi)
+	 {
+		pos = (lo + hi) / 2;
+		rec = get32 (index + pos * INDEXSIZE);
+		cmp = cmpname (db,rec,score->name);
+		if (cmp < 0 || (cmp == 0 && rec < rank)) lo = pos + 1; else hi = pos;
+	 }
+   memmove (index + (lo + 1) * INDEXSIZE,index + lo * INDEXSIZE,(count - lo) * INDEXSIZE);
+   put32 (index + lo * INDEXSIZE,rank);
+   return (rank);
+}
+
+/* Write a whole buffer at the given offset */
+static bool writeall (int fd,const unsigned char *buf,size_t len,off_t ofs)
+{
+   ssize_t result;
+   while (len)
+	 {
+		if ((result = pwrite (fd,buf,len,ofs)) < 0)
+		  {
+			 if (errno == EINTR) continue;
+			 return FALSE;
+		  }
+		buf += result;
+		ofs += result;
+		len -= result;
+	 }
+   return TRUE;
+}
+
+/*
+ * Replace the contents of the (locked) score file with the table. The table
+ * is written to a temporary file which is renamed over the score file, so
+ * readers never see a partial table. If we may not create files next to the
+ * score file, it is rewritten in place while we hold the lock.
+ */
+bool scoredb_write (const scoredb_t *db,int fd,const char *filename)
+{
+   char tmp[strlen (filename) + 8];
+   int tfd;
+   snprintf (tmp,sizeof (tmp),"%s.XXXXXX",filename);
+   if ((tfd = mkstemp (tmp)) < 0)
+	 return (ftruncate (fd,0) == 0 && writeall (fd,db->image,db->size,0) && fsync (fd) == 0);
+   if (writeall (tfd,db->image,db->size,0) && fchmod (tfd,SCOREFILEMODE) == 0 && fsync (tfd) == 0 && close (tfd) == 0)
+	 {
+		if (rename (tmp,filename) == 0) return TRUE;
+		unlink (tmp);
+		return FALSE;
+	 }
+   close (tfd);
+   unlink (tmp);
+   return FALSE;
+}
+
+/*
+ * Open and lock the score file, creating it if necessary. Operation is
+ * LOCK_SH or LOCK_EX. Returns -1 if we couldn't get hold of the file.
+ */
+int scoredb_lock (const char *filename,int operation)
+{
+   struct stat fst,pst;
+   int i,fd;
+   for (i = 0; i < LOCKTRIES; i++)
+	 {
+		if ((fd = open (filename,O_RDWR | O_CREAT,SCOREFILEMODE)) < 0) return -1;
+		if (flock (fd,operation | LOCK_NB) == 0)
+		  {
+			 /* Whoever held the lock may have renamed a new table over the one we opened */
+			 if (fstat (fd,&fst) == 0 && stat (filename,&pst) == 0 && fst.st_dev == pst.st_dev && fst.st_ino == pst.st_ino)
+			   return fd;
+		  }
+		else if (errno != EWOULDBLOCK)
+		  {
+			 close (fd);
+			 return -1;
+		  }
+		close (fd);
+		usleep (LOCKWAIT);
+	 }
+   return -1;
+}
+
+		  /***************************************************************************/
+		  /***************************************************************************/
+		  /***************************************************************************/
+
+/* Get the player's name, asking for it if prompt is TRUE */
+static void getname (char *name,bool prompt)
+{
+   struct passwd *pw = getpwuid (geteuid ());
+
+   name[0] = '\0';
+   if (prompt)
+	 {
+		fprintf (stderr,"Congratulations! You have a new high score.\n");
+		fprintf (stderr,"Enter your name [%s]: ",pw != NULL ? pw->pw_name : "");
+
+		if (fgets (name,NAMELEN - 1,stdin) == NULL) name[0] = '\0';
+		name[strcspn (name,"\n")] = '\0';
+	 }
+
+   if (!strlen (name) && pw != NULL)
+	 {
+		strncpy (name,pw->pw_name,NAMELEN);
+		name[NAMELEN - 1] = '\0';
+	 }
+}
+
+static void err1 ()
+{
+   fprintf (stderr,"Error creating %s\n",scorefile);
+   exit (EXIT_FAILURE);
+}
+
+static void err2 ()
+{
+   fprintf (stderr,"Error writing to %s\n",scorefile);
+   exit (EXIT_FAILURE);
+}
+
+/* Show the high scores. Rank is that of the player's new score (-1 if it */
+/* wasn't saved), best that of the player's best score (-1 if none) */
+static void showscores (const score_t *top,int count,int rank,const score_t *entry,int best,const score_t *bestscore)
+{
+   int i;
+   fprintf (stderr,"%s",scoretitle);
+   for (i = 0; i < count; i++)
+	 fprintf (stderr,"\t %2d%c %7d        %s\n",i + 1,i == rank ? '*' : ' ',top[i].score,top[i].name);
+   if (rank >= count)
+	 fprintf (stderr,"\t    ...\n\t %2d* %7d        %s\n",rank + 1,entry->score,entry->name);
+   if (best >= 0 && best != rank)
+	 fprintf (stderr,"\n\tYour best: %d (rank %d)\n",bestscore->score,best + 1);
+   fprintf (stderr,"\n");
+}
+
+/* Show the high scores from a table */
+static void showtable (const scoredb_t *db,int rank,const score_t *entry)
+{
+   score_t top[NUMSCORES],bestscore;
+   int i,best = -1;
+   for (i = 0; i < NUMSCORES && i < scoredb_count (db); i++) scoredb_get (db,i,&top[i]);
+   if (entry != NULL && (best = scoredb_best (db,entry->name)) >= 0) scoredb_get (db,best,&bestscore);
+   showscores (top,i,rank,entry,best,&bestscore);
+}
+
+static void file_savescores (int score,const char *name);
+
+/*
+ * Score daemon client
+ */
+
+/* Connect to the score daemon. Returns -1 if it isn't running */
+static int scored_connect ()
+{
+   struct sockaddr_un addr;
+   int fd;
+   if ((fd = socket (AF_UNIX,SOCK_STREAM,0)) < 0) return -1;
+   memset (&addr,0,sizeof (addr));
+   addr.sun_family = AF_UNIX;
+   strncpy (addr.sun_path,scoresocket,sizeof (addr.sun_path) - 1);
+   if (connect (fd,(struct sockaddr *) &addr,sizeof (addr)) < 0)
+	 {
+		close (fd);
+		return -1;
+	 }
+   return fd;
+}
+
+/* Number of complete replies in the buffer */
+static int scored_replies (const char *reply)
+{
+   const char *line,*end;
+   int count = 0;
+   for (line = reply; (end = strchr (line,'\n')) != NULL; line = end + 1)
+	 if (end - line == strlen (SCORED_END) && strncmp (line,SCORED_END,end - line) == 0) count++;
+   return count;
+}
+
+/* Send a batch of requests to the score daemon. Returns FALSE if the daemon */
+/* went away (without killing us with SIGPIPE) before it got all of them */
+static bool scored_send (int fd,const char *request)
+{
+   size_t len = strlen (request);
+   ssize_t result;
+   while (len)
+	 {
+		if ((result = send (fd,request,len,MSG_NOSIGNAL)) < 0)
+		  {
+			 if (errno == EINTR) continue;
+			 return FALSE;
+		  }
+		request += result;
+		len -= result;
+	 }
+   return TRUE;
+}
+
+/* Wait until count requests sent to the score daemon are answered. Returns */
+/* FALSE if the daemon doesn't answer */
+static bool scored_wait (int fd,int count,char *reply,size_t size)
+{
+   struct pollfd pfd;
+   size_t len = 0;
+   ssize_t result;
+   reply[0] = '\0';
+   while (scored_replies (reply) < count)
+	 {
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		if (len + 1 >= size || poll (&pfd,1,SCORED_TIMEOUT) <= 0) return FALSE;
+		if ((result = read (fd,reply + len,size - len - 1)) <= 0) return FALSE;
+		len += result;
+		reply[len] = '\0';
+	 }
+   return TRUE;
+}
+
+/* Send a batch of requests to the score daemon and wait until all of them */
+/* are answered. Returns FALSE if the daemon doesn't answer */
+static bool scored_request (int fd,const char *request,int count,char *reply,size_t size)
+{
+   return (scored_send (fd,request) && scored_wait (fd,count,reply,size));
+}
+
+/* Save the score through the score daemon. Returns FALSE if the daemon isn't */
+/* running or stopped answering before it got the score */
+static bool scored_savescores (int score)
+{
+   char request[3 * (NAMELEN + 64)],reply[SCORED_REPLYSIZE],*line,*refused = NULL;
+   score_t top[NUMSCORES],entry,bestscore,tmp;
+   int fd,rank = -1,best = -1,count = 0,block,blocks,toplist,value,n;
+   long long timestamp;
+   bool sent;
+   if ((fd = scored_connect ()) < 0) return FALSE;
+   if (score > 0)
+	 {
+		snprintf (request,sizeof (request),"RANK %d\n",score);
+		if (!scored_request (fd,request,1,reply,sizeof (reply)) || sscanf (reply,"RANK %d",&rank) != 1)
+		  {
+			 close (fd);
+			 return FALSE;
+		  }
+	 }
+   if (score > 0 && rank < MAXSCORES)
+	 {
+		getname (entry.name,rank < NUMSCORES);
+		entry.score = score;
+		entry.timestamp = time (NULL);
+		snprintf (request,sizeof (request),"ADD %d %lld %s\nTOP %d\nBEST %s\n",
+				  entry.score,(long long) entry.timestamp,entry.name,NUMSCORES,entry.name);
+		blocks = 3;
+		toplist = 1;
+	 }
+   else
+	 {
+		snprintf (request,sizeof (request),"TOP %d\n",NUMSCORES);
+		blocks = 1;
+		toplist = 0;
+	 }
+   rank = -1;
+   if (!(sent = scored_send (fd,request)) || !scored_wait (fd,blocks,reply,sizeof (reply)))
+	 {
+		close (fd);
+		if (blocks == 1) return FALSE;
+		/* A score that never reached the daemon is ours to save */
+		if (!sent)
+		  {
+			 fprintf (stderr,"The score daemon went away, saving your score in %s\n",scorefile);
+			 file_savescores (score,entry.name);
+		  }
+		else fprintf (stderr,"The score daemon isn't answering, your score may not have been saved\n");
+		return TRUE;
+	 }
+   close (fd);
+   /* Replies come in the same order as the requests */
+   for (block = 0,line = strtok (reply,"\n"); line != NULL; line = strtok (NULL,"\n"))
+	 {
+		if (strcmp (line,SCORED_END) == 0) block++;
+		else if (block == 0 && toplist && strncmp (line,"ERR ",4) == 0) refused = line + 4;
+		else if (sscanf (line,"RANK %d",&value) == 1) rank = value;
+		else if (sscanf (line,"SCORE %d %d %lld %n",&value,&tmp.score,&timestamp,&n) == 3)
+		  {
+			 strncpy (tmp.name,line + n,NAMELEN - 1);
+			 tmp.name[NAMELEN - 1] = '\0';
+			 tmp.timestamp = timestamp;
+			 if (block == toplist && count < NUMSCORES) top[count++] = tmp;
+			 else if (block == toplist + 1)
+			   {
+				  best = value;
+				  bestscore = tmp;
+			   }
+		  }
+	 }
+   /* Don't lose the score, or ask for the name again */
+   if (refused != NULL)
+	 {
+		fprintf (stderr,"The score daemon didn't take your score (%s), saving it in %s\n",refused,scorefile);
+		file_savescores (score,entry.name);
+		return TRUE;
+	 }
+   showscores (top,count,rank,&entry,best,&bestscore);
+   return TRUE;
+}
+
+/*
+ * Score file
+ */
+
+/* Save the score in the score file. The player is asked for a name if name is NULL */
+static void file_savescores (int score,const char *name)
+{
+   scoredb_t db;
+   score_t entry;
+   int fd,rank;
+   /* Have a look at the table first, so we don't keep it locked while the player types */
+   if ((fd = scoredb_lock (scorefile,LOCK_SH)) < 0) err1 ();
+   if (!scoredb_load (&db,fd))
+	 {
+		fprintf (stderr,"%s is corrupt, not saving scores\n",scorefile);
+		close (fd);
+		return;
+	 }
+   rank = score > 0 ? scoredb_rank (&db,score) : MAXSCORES;
+   if (rank >= MAXSCORES)
+	 {
+		showtable (&db,-1,NULL);
+		scoredb_free (&db);
+		close (fd);
+		return;
+	 }
+   scoredb_free (&db);
+   close (fd);
+   /* Only the high score list is shown, so only ask for a name if the score makes it in there */
+   if (name != NULL)
+	 {
+		strncpy (entry.name,name,NAMELEN - 1);
+		entry.name[NAMELEN - 1] = '\0';
+	 }
+   else getname (entry.name,rank < NUMSCORES);
+   entry.score = score;
+   entry.timestamp = time (NULL);
+   /* Someone else may have updated the table meanwhile, so read it again */
+   if ((fd = scoredb_lock (scorefile,LOCK_EX)) < 0) err2 ();
+   if (!scoredb_load (&db,fd))
+	 {
+		fprintf (stderr,"%s is corrupt, not saving scores\n",scorefile);
+		close (fd);
+		return;
+	 }
+   rank = scoredb_add (&db,&entry);
+   if (rank >= 0 && !scoredb_write (&db,fd,scorefile)) err2 ();
+   close (fd);
+   showtable (&db,rank,&entry);
+   scoredb_free (&db);
+}
+
+/*
+ * Save the player's score in the score file and show the high scores
+ */
+void savescores (int score)
+{
+   if (!scored_savescores (score)) file_savescores (score,NULL);
+}
@@ -0,0 +1,157 @@
+#ifndef SCORES_H
+#define SCORES_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <time.h>			/* time_t */
+#include <stddef.h>			/* size_t */
+
+#include "typedefs.h"		/* bool */
+
+/*
+ * Macros
+ */
+
+/* Length of a player's name */
+#define NAMELEN 20
+
+/* Number of scores shown in the highscore list */
+#define NUMSCORES 10
+
+/* Number of scores kept in the score file */
+#define MAXSCORES 65536
+
+/*
+ * Type definitions
+ */
+
+typedef struct
+{
+   char name[NAMELEN];
+   int score;
+   time_t timestamp;
+} score_t;
+
+/*
+ * The score file starts with a header, followed by fixed size records sorted
+ * from best to worst score and an index of record numbers sorted by name.
+ * All numbers are stored little endian, so the file is the same everywhere.
+ * The table is either mapped straight from the file or, once modified or
+ * migrated from the old format, held in memory.
+ */
+typedef struct
+{
+   unsigned char *image;	/* header, records, name index */
+   size_t size;				/* size of image */
+   bool mapped;				/* image is mmap()ed from the score file */
+} scoredb_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Load the score table from an open score file. An empty file gives an
+ * empty table and files in the old format are converted. Returns FALSE
+ * if the file is corrupt.
+ */
+bool scoredb_load (scoredb_t *db,int fd);
+
+/*
+ * Release the score table
+ */
+void scoredb_free (scoredb_t *db);
+
+/*
+ * Number of scores in the table
+ */
+int scoredb_count (const scoredb_t *db);
+
+/*
+ * Get the score at the given rank (0 is the best)
+ */
+void scoredb_get (const scoredb_t *db,int rank,score_t *score);
+
+/*
+ * Rank of the best score of the specified player, -1 if there is none
+ */
+int scoredb_best (const scoredb_t *db,const char *name);
+
+/*
+ * Rank a new score would get. Returns MAXSCORES if it won't make it into the table
+ */
+int scoredb_rank (const scoredb_t *db,int score);
+
+/*
+ * Rank of the given score if it is in the table, -1 otherwise
+ */
+int scoredb_find (const scoredb_t *db,const score_t *score);
+
+/*
+ * Add a score to the table. Returns its rank or -1 if it didn't make it
+ * into the table (or we ran out of memory).
+ */
+int scoredb_add (scoredb_t *db,const score_t *score);
+
+/*
+ * Replace the contents of the (locked) score file with the table
+ */
+bool scoredb_write (const scoredb_t *db,int fd,const char *filename);
+
+/*
+ * Open and lock the score file, creating it if necessary. Operation is
+ * LOCK_SH or LOCK_EX. Returns -1 if we couldn't get hold of the file.
+ */
+int scoredb_lock (const char *filename,int operation);
+
+/*
+ * The score daemon (tintd) keeps the table in memory and takes requests over
+ * a Unix domain socket. Requests are lines of text and any number of them
+ * may be sent at once. Each is answered with zero or more lines followed by
+ * a line containing only SCORED_END:
+ *
+ *   ADD <score> <timestamp> <name>   RANK <rank> (-1 if it didn't make it)
+ *   RANK <score>                     RANK <rank the score would get>
+ *   TOP <n>                          SCORE <rank> <score> <timestamp> <name>, best first
+ *   BEST <name>                      SCORE <rank> <score> <timestamp> <name>, if any
+ *
+ * Anything else gets ERR <message>, and so does ADD if it can't be added or
+ * the client isn't tint (running as the group of the score file).
+ */
+#define SCORED_END "END"
+
+/* Most scores a TOP request returns */
+#define SCORED_MAXTOP 100
+
+/*
+ * Save the player's score in the score file and show the high scores
+ */
+void savescores (int score);
+
+#endif	/* #ifndef SCORES_H */
@@ -0,0 +1,1117 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Game server. Plays tint with many telnet clients at once. Every thread
+ * has its own listening sockets (SO_REUSEPORT, so the kernel spreads new
+ * connections over the threads) and its own epoll loop, and a session stays
+ * with the thread that accepted it, so sessions never need locking. Each
+ * session has a game, an ANSI renderer that draws into the session's output
+ * buffer and a timerfd that moves the shape down.
+ *
+ * Spectators connect to a second port and pick a game. They are handed to
+ * the thread playing that game, which copies every frame it encodes for the
+ * player once into a reference counted buffer and queues that buffer for
+ * all spectators. Spectators who fall too far behind lose their queue and
+ * get a keyframe of the whole screen once they caught up.
+ */
+
+#define _GNU_SOURCE		/* accept4() */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "io.h"
+#include "engine.h"
+#include "game.h"
+#include "telemetry.h"
+
+/*
+ * Macros
+ */
+
+/* Ports we listen on if none are given */
+#define DEFAULT_PORT 2323
+#define DEFAULT_WATCHPORT 2324
+
+/* Size of the screen we draw on. Telnet clients don't tell us theirs */
+#define WIDTH	80
+#define HEIGHT	24
+
+/* Most epoll events handled at once */
+#define MAXEVENTS 64
+
+/* Most output we keep for a player that doesn't read it */
+#define MAXOUTPUT 262144
+
+/* Most frames queued for a spectator before we skip to a keyframe */
+#define MAXQUEUE 16
+
+/* Size of the input buffer */
+#define INSIZE 512
+
+/* Most games listed for a spectator */
+#define MAXLIST 40
+
+/* Telnet commands */
+#define IAC		255
+#define DONT	254
+#define DO		253
+#define WONT	252
+#define WILL	251
+#define SB		250
+#define SE		240
+
+/* Telnet options */
+#define TELOPT_ECHO	1
+#define TELOPT_SGA	3
+
+/*
+ * Type definitions
+ */
+
+typedef enum
+{
+   WATCH_PLAYERS,		/* listening socket for players */
+   WATCH_SPECTATORS,	/* listening socket for spectators */
+   WATCH_HANDOFF,		/* eventfd, spectators were handed to us */
+   WATCH_SESSION,		/* player */
+   WATCH_TIMER,			/* game clock */
+   WATCH_LOBBY,			/* spectator choosing a game */
+   WATCH_VIEWER			/* spectator watching a game */
+} watchkind_t;
+
+/* Something epoll watches */
+typedef struct
+{
+   int fd;
+   watchkind_t kind;
+   void *ptr;			/* what it belongs to */
+} watch_t;
+
+typedef enum { TELNET_DATA, TELNET_CR, TELNET_IAC, TELNET_OPTION, TELNET_SB, TELNET_SBIAC } telnet_t;
+
+/* Encoded frame, shared by all spectators of a game */
+typedef struct
+{
+   int refs;
+   size_t len;
+   char data[];
+} frame_t;
+
+typedef struct viewer_struct
+{
+   watch_t sock;
+   frame_t *queue[MAXQUEUE];		/* frames not written yet, the first one partly */
+   int head,count;
+   size_t ofs;						/* bytes of the first frame already written */
+   bool keyframe;					/* skip frames until we can send a keyframe */
+   bool writing;					/* waiting for the socket to take more */
+   bool dead;						/* drop the spectator */
+   struct viewer_struct *next;
+} viewer_t;
+
+typedef struct session_struct
+{
+   game_t game;					/* draws with its own renderer */
+   unsigned id;					/* game number shown to spectators */
+   watch_t sock;					/* client socket */
+   watch_t timer;					/* timerfd for the game clock */
+   long long epoch;				/* when tick 0 of the game was due, in microseconds */
+   char *out;						/* output the socket didn't take yet */
+   size_t outlen,outsize;
+   bool flushed;					/* the game emptied the keyboard buffer */
+   bool dead;						/* drop the session */
+   telnet_t telnet;				/* telnet parser state */
+   viewer_t *viewers;				/* spectators */
+   struct session_struct *next;	/* list of dead sessions */
+} session_t;
+
+/* Spectator choosing a game */
+typedef struct
+{
+   watch_t sock;
+   telnet_t telnet;
+   char line[12];
+   int len;
+} lobby_t;
+
+/* Spectator on the way to the thread playing the game */
+typedef struct handoff_struct
+{
+   int fd;
+   unsigned id;
+   struct handoff_struct *next;
+} handoff_t;
+
+typedef struct
+{
+   int epfd;
+   watch_t players,spectators;	/* listening sockets */
+   watch_t handoff;				/* eventfd, signalled when handoffs is not empty */
+   pthread_mutex_t lock;			/* protects handoffs */
+   handoff_t *handoffs;
+} thread_t;
+
+/* Where to find a game */
+typedef struct
+{
+   unsigned id;
+   thread_t *thread;
+   session_t *session;			/* only to be used by thread */
+} entry_t;
+
+/*
+ * Global variables
+ */
+
+static const char *address = "127.0.0.1";
+static int port = DEFAULT_PORT,watchport = DEFAULT_WATCHPORT;
+static int numthreads;
+static thread_t *threads;
+
+/* Options every game starts with */
+static game_t options;
+
+/* Copy of io_ansi that keeps time and input per session */
+static io_backend_t io_server;
+
+/* Games being played */
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static entry_t *registry;
+static int numentries,maxentries;
+static unsigned lastid;
+
+/* Thread we are */
+static __thread thread_t *self;
+
+/* Session being played in this thread */
+static __thread session_t *current;
+
+/* Spectators to free after this round of events */
+static __thread viewer_t *graveyard;
+
+/*
+ * Functions
+ */
+
+static void die (const char *msg)
+{
+   fprintf (stderr,"tint-server: %s: %s\n",msg,strerror (errno));
+   exit (EXIT_FAILURE);
+}
+
+#ifdef PROFILE
+/* The server only stops on a signal. Leave through exit () so the profile gets printed */
+static void stop (int sig)
+{
+   exit (EXIT_SUCCESS);
+}
+#endif
+
+/* Tell epoll what to wait for */
+static void watch (watch_t *w,int op,uint32_t events)
+{
+   struct epoll_event ev;
+   ev.events = events;
+   ev.data.ptr = w;
+   if (epoll_ctl (self->epfd,op,w->fd,&ev) < 0 && op == EPOLL_CTL_ADD) die ("epoll_ctl");
+}
+
+/* Send something small to a client that has just connected */
+static void greet (int fd,const char *str)
+{
+   send (fd,str,strlen (str),MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+/*
+ * Registry
+ */
+
+/* Make a game known to spectators. Returns its number */
+static unsigned addgame (session_t *session)
+{
+   unsigned id;
+   pthread_mutex_lock (&registry_lock);
+   if (numentries == maxentries)
+	 {
+		maxentries = maxentries ? maxentries * 2 : 64;
+		if ((registry = realloc (registry,maxentries * sizeof (entry_t))) == NULL) die ("realloc");
+	 }
+   id = ++lastid;
+   registry[numentries].id = id;
+   registry[numentries].thread = self;
+   registry[numentries].session = session;
+   numentries++;
+   pthread_mutex_unlock (&registry_lock);
+   return id;
+}
+
+static void removegame (unsigned id)
+{
+   int i;
+   pthread_mutex_lock (&registry_lock);
+   for (i = 0; i < numentries; i++)
+	 if (registry[i].id == id)
+	   {
+		  registry[i] = registry[--numentries];
+		  break;
+	   }
+   pthread_mutex_unlock (&registry_lock);
+}
+
+/* Find a game. Returns FALSE if nobody plays it (anymore) */
+static bool findgame (unsigned id,entry_t *entry)
+{
+   int i;
+   pthread_mutex_lock (&registry_lock);
+   for (i = 0; i < numentries; i++)
+	 if (registry[i].id == id)
+	   {
+		  *entry = registry[i];
+		  break;
+	   }
+   pthread_mutex_unlock (&registry_lock);
+   return (i < numentries);
+}
+
+/* List the games being played */
+static void listgames (int fd)
+{
+   char buf[MAXLIST * 12 + 64];
+   int i,len;
+   pthread_mutex_lock (&registry_lock);
+   len = snprintf (buf,sizeof (buf),"%d games being played:",numentries);
+   for (i = 0; i < numentries && i < MAXLIST; i++) len += sprintf (buf + len," %u",registry[i].id);
+   pthread_mutex_unlock (&registry_lock);
+   strcpy (buf + len,i < numentries ? " ...\r\nWatch game: " : "\r\nWatch game: ");
+   greet (fd,buf);
+}
+
+/*
+ * Spectators
+ */
+
+static void releaseframe (frame_t *frame)
+{
+   if (!--frame->refs) free (frame);
+}
+
+/* Forget the frames queued for a spectator, except one that's partly written */
+static void dropframes (viewer_t *viewer)
+{
+   int keep = viewer->ofs > 0;
+   while (viewer->count > keep)
+	 {
+		releaseframe (viewer->queue[(viewer->head + viewer->count - 1) % MAXQUEUE]);
+		viewer->count--;
+	 }
+}
+
+static void freeviewer (viewer_t *viewer)
+{
+   viewer->ofs = 0;
+   dropframes (viewer);
+   close (viewer->sock.fd);
+   free (viewer);
+}
+
+static void queueframe (viewer_t *viewer,frame_t *frame)
+{
+   viewer->queue[(viewer->head + viewer->count++) % MAXQUEUE] = frame;
+   frame->refs++;
+}
+
+static void sendframes (viewer_t *viewer,session_t *session);
+
+/* Keyframes are only for one spectator, but travel the same way */
+static void keyframe_sink (void *arg,const char *data,size_t len)
+{
+   viewer_t *viewer = arg;
+   frame_t *frame;
+   if ((frame = malloc (sizeof (frame_t) + len)) == NULL) return;
+   frame->refs = 0;
+   frame->len = len;
+   memcpy (frame->data,data,len);
+   queueframe (viewer,frame);
+}
+
+/* Write as many queued frames as the socket takes, with a single writev () */
+static void sendframes (viewer_t *viewer,session_t *session)
+{
+   struct iovec iov[MAXQUEUE];
+   frame_t *frame;
+   ssize_t result;
+   int i;
+   for (;;)
+	 {
+		if (!viewer->count)
+		  {
+			 if (!viewer->keyframe) break;
+			 /* Caught up, start over from what the player sees */
+			 viewer->keyframe = FALSE;
+			 ansi_keyframe (session->game.renderer,keyframe_sink,viewer);
+			 continue;
+		  }
+		for (i = 0; i < viewer->count; i++)
+		  {
+			 frame = viewer->queue[(viewer->head + i) % MAXQUEUE];
+			 iov[i].iov_base = frame->data + (i ? 0 : viewer->ofs);
+			 iov[i].iov_len = frame->len - (i ? 0 : viewer->ofs);
+		  }
+		if ((result = writev (viewer->sock.fd,iov,viewer->count)) < 0)
+		  {
+			 if (errno == EINTR) continue;
+			 if (errno != EAGAIN && errno != EWOULDBLOCK) viewer->dead = TRUE;
+			 break;
+		  }
+		viewer->ofs += result;
+		while (viewer->count && viewer->ofs >= viewer->queue[viewer->head]->len)
+		  {
+			 viewer->ofs -= viewer->queue[viewer->head]->len;
+			 releaseframe (viewer->queue[viewer->head]);
+			 viewer->head = (viewer->head + 1) % MAXQUEUE;
+			 viewer->count--;
+		  }
+		if (viewer->count) break;
+	 }
+   if (viewer->dead) return;
+   if (viewer->writing != (viewer->count > 0))
+	 {
+		viewer->writing = viewer->count > 0;
+		watch (&viewer->sock,EPOLL_CTL_MOD,viewer->writing ? EPOLLIN | EPOLLOUT : EPOLLIN);
+	 }
+}
+
+/* Stop sending to spectators whose connection failed. They are freed after this round of events */
+static void reapviewers (session_t *session)
+{
+   viewer_t **viewer = &session->viewers,*dead;
+   while (*viewer != NULL)
+	 if ((*viewer)->dead)
+	   {
+		  dead = *viewer;
+		  *viewer = dead->next;
+		  dead->next = graveyard;
+		  graveyard = dead;
+	   }
+	 else viewer = &(*viewer)->next;
+}
+
+/* Queue a frame for all spectators of a game. It's copied once, whatever their number */
+static void broadcast (session_t *session,const char *data,size_t len)
+{
+   frame_t *frame;
+   viewer_t *viewer;
+   if (session->viewers == NULL) return;
+   if ((frame = malloc (sizeof (frame_t) + len)) == NULL) return;
+   frame->refs = 1;
+   frame->len = len;
+   memcpy (frame->data,data,len);
+   for (viewer = session->viewers; viewer != NULL; viewer = viewer->next)
+	 {
+		/* The keyframe will include this frame */
+		if (viewer->keyframe) continue;
+		if (viewer->count == MAXQUEUE)
+		  {
+			 dropframes (viewer);
+			 viewer->keyframe = TRUE;
+			 continue;
+		  }
+		queueframe (viewer,frame);
+		if (viewer->count == 1) sendframes (viewer,session);
+	 }
+   releaseframe (frame);
+   reapviewers (session);
+}
+
+/* Spectator handed to us by another thread (or ourselves) */
+static void addviewer (int fd,unsigned id)
+{
+   entry_t entry;
+   viewer_t *viewer;
+   if (!findgame (id,&entry) || entry.thread != self || (viewer = calloc (1,sizeof (viewer_t))) == NULL)
+	 {
+		greet (fd,"\r\nThat game is over\r\n");
+		close (fd);
+		return;
+	 }
+   viewer->sock.fd = fd;
+   viewer->sock.kind = WATCH_VIEWER;
+   viewer->sock.ptr = entry.session;
+   viewer->keyframe = TRUE;
+   viewer->next = entry.session->viewers;
+   entry.session->viewers = viewer;
+   watch (&viewer->sock,EPOLL_CTL_ADD,EPOLLIN);
+   sendframes (viewer,entry.session);
+   reapviewers (entry.session);
+}
+
+/* Spectators don't get to say anything, other than that they've had enough */
+static void readviewer (viewer_t *viewer)
+{
+   char buf[INSIZE];
+   ssize_t n;
+   if ((n = read (viewer->sock.fd,buf,sizeof (buf))) == 0 || (n < 0 && errno != EAGAIN && errno != EINTR) ||
+	   (n > 0 && memchr (buf,'q',n) != NULL))
+	 viewer->dead = TRUE;
+}
+
+static void handoffs ()
+{
+   handoff_t *handoff,*next;
+   uint64_t n;
+   read (self->handoff.fd,&n,sizeof (n));
+   pthread_mutex_lock (&self->lock);
+   handoff = self->handoffs;
+   self->handoffs = NULL;
+   pthread_mutex_unlock (&self->lock);
+   for (; handoff != NULL; handoff = next)
+	 {
+		next = handoff->next;
+		addviewer (handoff->fd,handoff->id);
+		free (handoff);
+	 }
+}
+
+/* Give a spectator to the thread playing the game */
+static void handoff (lobby_t *lobby,unsigned id)
+{
+   entry_t entry;
+   handoff_t *handoff;
+   uint64_t one = 1;
+   if (!findgame (id,&entry) || (handoff = malloc (sizeof (handoff_t))) == NULL)
+	 {
+		greet (lobby->sock.fd,"\r\nNo such game\r\n");
+		listgames (lobby->sock.fd);
+		lobby->len = 0;
+		return;
+	 }
+   epoll_ctl (self->epfd,EPOLL_CTL_DEL,lobby->sock.fd,NULL);
+   handoff->fd = lobby->sock.fd;
+   handoff->id = id;
+   pthread_mutex_lock (&entry.thread->lock);
+   handoff->next = entry.thread->handoffs;
+   entry.thread->handoffs = handoff;
+   pthread_mutex_unlock (&entry.thread->lock);
+   write (entry.thread->handoff.fd,&one,sizeof (one));
+   free (lobby);
+}
+
+static void newlobby (int fd)
+{
+   static const char negotiate[] = { IAC, WILL, TELOPT_ECHO, IAC, WILL, TELOPT_SGA, IAC, DO, TELOPT_SGA, 0 };
+   lobby_t *lobby;
+   if ((lobby = calloc (1,sizeof (lobby_t))) == NULL)
+	 {
+		close (fd);
+		return;
+	 }
+   lobby->sock.fd = fd;
+   lobby->sock.kind = WATCH_LOBBY;
+   lobby->sock.ptr = lobby;
+   lobby->telnet = TELNET_DATA;
+   watch (&lobby->sock,EPOLL_CTL_ADD,EPOLLIN);
+   greet (fd,negotiate);
+   listgames (fd);
+}
+
+/*
+ * Players
+ */
+
+/* Have epoll tell us when the socket can take more, but only while we have something for it */
+static void watchoutput (session_t *session,bool enable)
+{
+   watch (&session->sock,EPOLL_CTL_MOD,enable ? EPOLLIN | EPOLLOUT : EPOLLIN);
+}
+
+/* Write as much of the queued output as the socket takes */
+static void flushoutput (session_t *session)
+{
+   ssize_t result;
+   size_t ofs = 0;
+   while (ofs < session->outlen)
+	 {
+		result = send (session->sock.fd,session->out + ofs,session->outlen - ofs,MSG_NOSIGNAL);
+		if (result < 0)
+		  {
+			 if (errno == EINTR) continue;
+			 if (errno != EAGAIN && errno != EWOULDBLOCK) session->dead = TRUE;
+			 break;
+		  }
+		ofs += result;
+	 }
+   memmove (session->out,session->out + ofs,session->outlen - ofs);
+   session->outlen -= ofs;
+}
+
+/* Send data to the client, queueing whatever the socket doesn't take right away */
+static void sendoutput (session_t *session,const char *data,size_t len)
+{
+   bool waiting = session->outlen > 0;
+   if (session->dead) return;
+   if (session->outlen + len > session->outsize)
+	 {
+		if (session->outlen + len > MAXOUTPUT)
+		  {
+			 session->dead = TRUE;
+			 return;
+		  }
+		session->outsize = session->outlen + len > 2 * session->outsize ? session->outlen + len : 2 * session->outsize;
+		if ((session->out = realloc (session->out,session->outsize)) == NULL)
+		  {
+			 session->outsize = session->outlen = 0;
+			 session->dead = TRUE;
+			 return;
+		  }
+	 }
+   memcpy (session->out + session->outlen,data,len);
+   session->outlen += len;
+   if (!waiting) flushoutput (session);
+   if (session->outlen > 0 && !waiting) watchoutput (session,TRUE);
+}
+
+/* Frames from the renderer go to the player and to everyone watching */
+static void session_sink (void *arg,const char *frame,size_t len)
+{
+   sendoutput (arg,frame,len);
+   broadcast (arg,frame,len);
+}
+
+/* Skip frames while the player hasn't read the last one. We draw again once they have */
+static bool session_busy (void *arg)
+{
+   session_t *session = arg;
+   return (session->outlen > 0);
+}
+
+/*
+ * Backend
+ */
+
+static void server_init ()
+{
+}
+
+static void server_close ()
+{
+}
+
+/* Input arrives through epoll, never through in_getch () */
+static int server_getch ()
+{
+   return ERR;
+}
+
+/* The timers of the sessions go off when their shapes are due to fall (see rearm ()), not every tick */
+static void server_timeout (int delay)
+{
+}
+
+/* Ignore the rest of what the client sent this time */
+static void server_flush ()
+{
+   current->flushed = TRUE;
+}
+
+/*
+ * Sessions
+ */
+
+/* Let the backend know whose clock and keyboard the game is talking about */
+static void play (session_t *session)
+{
+   current = session;
+}
+
+/* Play the ticks of the game that are due. Returns TRUE if the shape moved */
+static bool catchup (session_t *session)
+{
+   game_t *game = &session->game;
+   long long now = microseconds ();
+   bool moved = FALSE;
+   /* The clock of a paused game stands still */
+   if (game->paused) session->epoch = now - (long long) game->tick * TICK;
+   while (!game->finished && session->epoch + (long long) (game->tick + 1) * TICK <= now) moved |= game_step (game);
+   return (moved);
+}
+
+/* Wake up in the tick the shape falls in. Nothing happens in the ticks before, or while the game is paused */
+static void rearm (session_t *session)
+{
+   const game_t *game = &session->game;
+   struct itimerspec its;
+   long long due = session->epoch + (long long) (game->tick + game_due (game)) * TICK;
+   memset (&its,0,sizeof (its));
+   if (!game->paused && !game->finished)
+	 {
+		its.it_value.tv_sec = due / 1000000;
+		its.it_value.tv_nsec = due % 1000000 * 1000;
+	 }
+   timerfd_settime (session->timer.fd,TFD_TIMER_ABSTIME,&its,NULL);
+}
+
+/* Say goodbye and drop the session once that has gone out */
+static void endsession (session_t *session)
+{
+   char buf[128];
+   int len;
+   close (session->timer.fd);
+   session->timer.fd = -1;
+   len = snprintf (buf,sizeof (buf),"\033[0m\033[2J\033[H\033[?25hGame over. The score was %d\r\n",GETSCORE (session->game.engine.score));
+   sendoutput (session,buf,len);
+   broadcast (session,buf,len);
+   if (!session->outlen) session->dead = TRUE;
+}
+
+static void freesession (session_t *session)
+{
+   viewer_t *viewer;
+   if (session->id) removegame (session->id);
+   /* Whoever still watches gets one more chance to read the end of the game */
+   while ((viewer = session->viewers) != NULL)
+	 {
+		session->viewers = viewer->next;
+		if (viewer->count > 0 && !viewer->dead) sendframes (viewer,session);
+		freeviewer (viewer);
+	 }
+   close (session->sock.fd);
+   if (session->timer.fd >= 0) close (session->timer.fd);
+   if (session->game.renderer != NULL) ansi_free (session->game.renderer);
+   free (session->out);
+   free (session);
+}
+
+static void newsession (int fd)
+{
+   static const char negotiate[] = { IAC, WILL, TELOPT_ECHO, IAC, WILL, TELOPT_SGA, IAC, DO, TELOPT_SGA };
+   session_t *session;
+   int one = 1;
+   if ((session = calloc (1,sizeof (session_t))) == NULL)
+	 {
+		close (fd);
+		return;
+	 }
+   session->sock.fd = fd;
+   session->sock.kind = WATCH_SESSION;
+   session->sock.ptr = session;
+   session->timer.kind = WATCH_TIMER;
+   session->timer.ptr = session;
+   session->telnet = TELNET_DATA;
+   game_init (&session->game,rand_value (INT_MAX));
+   if ((session->timer.fd = timerfd_create (CLOCK_MONOTONIC,TFD_NONBLOCK | TFD_CLOEXEC)) < 0 ||
+	   (session->game.renderer = ansi_new (WIDTH,HEIGHT,session_sink,session_busy,session)) == NULL)
+	 {
+		freesession (session);
+		return;
+	 }
+   setsockopt (fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof (one));
+   watch (&session->sock,EPOLL_CTL_ADD,EPOLLIN);
+   watch (&session->timer,EPOLL_CTL_ADD,EPOLLIN);
+   session->game.level = options.level;
+   session->game.shownext = options.shownext;
+   session->game.dottedlines = options.dottedlines;
+   session->game.shadow = options.shadow;
+   session->game.blockchar = options.blockchar;
+   session->id = session->game.id = addgame (session);
+   /* We echo, and characters are sent as they are typed */
+   sendoutput (session,negotiate,sizeof (negotiate));
+   play (session);
+   game_start (&session->game);
+   session->epoch = microseconds ();
+   rearm (session);
+   out_setcolor (COLOR_WHITE,COLOR_BLACK);
+   out_gotoxy (WIDTH - 12,HEIGHT - 1);
+   out_printf ("Game %u",session->id);
+   game_draw (&session->game);
+}
+
+/* Strip telnet commands from what a client sent. Returns the number of bytes left */
+static int telnet (telnet_t *state,unsigned char *buf,int len)
+{
+   int i,n = 0;
+   for (i = 0; i < len; i++)
+	 switch (*state)
+	   {
+		case TELNET_DATA:
+		  if (buf[i] == IAC) *state = TELNET_IAC;
+		  else if (buf[i] == '\r')
+			{
+			   buf[n++] = '\n';
+			   *state = TELNET_CR;
+			}
+		  else buf[n++] = buf[i];
+		  break;
+		  /* Enter is sent as CR LF or CR NUL */
+		case TELNET_CR:
+		  *state = TELNET_DATA;
+		  if (buf[i] != '\n' && buf[i] != '\0') i--;
+		  break;
+		case TELNET_IAC:
+		  *state = TELNET_DATA;
+		  if (buf[i] >= WILL && buf[i] <= DONT) *state = TELNET_OPTION;
+		  else if (buf[i] == SB) *state = TELNET_SB;
+		  else if (buf[i] == IAC) buf[n++] = IAC;
+		  break;
+		case TELNET_OPTION:
+		  *state = TELNET_DATA;
+		  break;
+		case TELNET_SB:
+		  if (buf[i] == IAC) *state = TELNET_SBIAC;
+		  break;
+		case TELNET_SBIAC:
+		  *state = buf[i] == SE ? TELNET_DATA : TELNET_SB;
+		  break;
+	   }
+   return n;
+}
+
+static void readsession (session_t *session)
+{
+   unsigned char buf[INSIZE];
+   int keys[INSIZE];
+   int i,n;
+   if ((n = read (session->sock.fd,buf,sizeof (buf))) <= 0)
+	 {
+		if (n == 0 || (errno != EAGAIN && errno != EINTR)) session->dead = TRUE;
+		return;
+	 }
+   /* The game is over, we're only waiting for the goodbye to go out */
+   if (session->game.finished) return;
+   n = ansi_keys (buf,telnet (&session->telnet,buf,n),keys,INSIZE);
+   play (session);
+   /* The keys go in the tick they came in */
+   catchup (session);
+   session->flushed = FALSE;
+   for (i = 0; i < n && !session->flushed && !session->game.finished; i++) game_key (&session->game,keys[i]);
+   if (session->game.finished) endsession (session);
+   else
+	 {
+		game_draw (&session->game);
+		/* The keys may have paused the game, or changed the level */
+		rearm (session);
+	 }
+}
+
+static void ticksession (session_t *session)
+{
+   uint64_t expirations;
+   bool moved;
+   if (session->timer.fd < 0 || read (session->timer.fd,&expirations,sizeof (expirations)) != sizeof (expirations)) return;
+   play (session);
+   moved = catchup (session);
+   if (session->game.finished) endsession (session);
+   else
+	 {
+		if (moved) game_draw (&session->game);
+		rearm (session);
+	 }
+}
+
+static void writesession (session_t *session)
+{
+   flushoutput (session);
+   if (session->outlen > 0) return;
+   watchoutput (session,FALSE);
+   /* Frames were skipped while the client was behind */
+   if (session->game.finished) session->dead = TRUE;
+   else
+	 {
+		play (session);
+		game_draw (&session->game);
+	 }
+}
+
+/* Read the number of the game a spectator wants to watch */
+static void readlobby (lobby_t *lobby)
+{
+   unsigned char buf[INSIZE];
+   int i,n,id;
+   if ((n = read (lobby->sock.fd,buf,sizeof (buf))) <= 0)
+	 {
+		if (n == 0 || (errno != EAGAIN && errno != EINTR))
+		  {
+			 close (lobby->sock.fd);
+			 free (lobby);
+		  }
+		return;
+	 }
+   n = telnet (&lobby->telnet,buf,n);
+   for (i = 0; i < n; i++)
+	 if (buf[i] == '\n')
+	   {
+		  lobby->line[lobby->len] = '\0';
+		  if (str2int (&id,lobby->line) && id > 0)
+			{
+			   handoff (lobby,id);
+			   return;
+			}
+		  greet (lobby->sock.fd,"\r\nWatch game: ");
+		  lobby->len = 0;
+	   }
+	 else if (buf[i] >= '0' && buf[i] <= '9' && lobby->len < sizeof (lobby->line) - 1)
+	   {
+		  lobby->line[lobby->len++] = buf[i];
+		  send (lobby->sock.fd,buf + i,1,MSG_NOSIGNAL | MSG_DONTWAIT);
+	   }
+}
+
+/*
+ * Threads
+ */
+
+static int listensocket (int port)
+{
+   struct sockaddr_in addr;
+   int fd,one = 1;
+   if ((fd = socket (AF_INET,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0)) < 0) die ("socket");
+   setsockopt (fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof (one));
+   /* Every thread listens on the same port, the kernel picks one for each connection */
+   if (setsockopt (fd,SOL_SOCKET,SO_REUSEPORT,&one,sizeof (one)) < 0) die ("SO_REUSEPORT");
+   memset (&addr,0,sizeof (addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons (port);
+   if (inet_pton (AF_INET,address,&addr.sin_addr) != 1)
+	 {
+		fprintf (stderr,"tint-server: invalid address -- %s\n",address);
+		exit (EXIT_FAILURE);
+	 }
+   if (bind (fd,(struct sockaddr *) &addr,sizeof (addr)) < 0) die (address);
+   if (listen (fd,SOMAXCONN) < 0) die ("listen");
+   return fd;
+}
+
+static void *serve (void *arg)
+{
+   struct epoll_event events[MAXEVENTS];
+   session_t *session,*dead;
+   viewer_t *viewer;
+   watch_t *w;
+   int fd,i,n;
+   self = arg;
+   watch (&self->players,EPOLL_CTL_ADD,EPOLLIN);
+   watch (&self->spectators,EPOLL_CTL_ADD,EPOLLIN);
+   watch (&self->handoff,EPOLL_CTL_ADD,EPOLLIN);
+   for (;;)
+	 {
+		if ((n = epoll_wait (self->epfd,events,MAXEVENTS,-1)) < 0)
+		  {
+			 if (errno == EINTR) continue;
+			 die ("epoll_wait");
+		  }
+		dead = NULL;
+		for (i = 0; i < n; i++)
+		  {
+			 w = events[i].data.ptr;
+			 switch (w->kind)
+			   {
+				case WATCH_PLAYERS:
+				  while ((fd = accept4 (w->fd,NULL,NULL,SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) newsession (fd);
+				  continue;
+				case WATCH_SPECTATORS:
+				  while ((fd = accept4 (w->fd,NULL,NULL,SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) newlobby (fd);
+				  continue;
+				case WATCH_HANDOFF:
+				  handoffs ();
+				  continue;
+				case WATCH_LOBBY:
+				  readlobby (w->ptr);
+				  continue;
+				default:
+				  break;
+			   }
+			 /* Sessions and spectators are only freed after all events of this round were handled */
+			 session = w->ptr;
+			 if (session->dead || (w->kind == WATCH_VIEWER && ((viewer_t *) w)->dead)) continue;
+			 switch (w->kind)
+			   {
+				case WATCH_TIMER:
+				  ticksession (session);
+				  break;
+				case WATCH_VIEWER:
+				  if (events[i].events & EPOLLOUT) sendframes ((viewer_t *) w,session);
+				  if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readviewer ((viewer_t *) w);
+				  reapviewers (session);
+				  break;
+				default:
+				  if (events[i].events & EPOLLOUT) writesession (session);
+				  if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readsession (session);
+			   }
+			 if (session->dead)
+			   {
+				  session->next = dead;
+				  dead = session;
+			   }
+		  }
+		while (dead != NULL)
+		  {
+			 session = dead;
+			 dead = dead->next;
+			 freesession (session);
+		  }
+		while (graveyard != NULL)
+		  {
+			 viewer = graveyard;
+			 graveyard = graveyard->next;
+			 freeviewer (viewer);
+		  }
+	 }
+   return NULL;
+}
+
+/* Allow a descriptor for the socket and the timer of every session we might get */
+static void raiselimit ()
+{
+   struct rlimit rl;
+   if (getrlimit (RLIMIT_NOFILE,&rl) == 0 && rl.rlim_cur < rl.rlim_max)
+	 {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit (RLIMIT_NOFILE,&rl);
+	 }
+}
+
+static void showhelp ()
+{
+   fprintf (stderr,"USAGE: tint-server [-h] [-a address] [-p port] [-w port] [-t threads] [-l level] [-n] [-d] [-b char] [-s] [-T file]\n");
+   fprintf (stderr,"  -h            Show this help message\n");
+   fprintf (stderr,"  -a <address>  Address to listen on (default %s)\n",address);
+   fprintf (stderr,"  -p <port>     Port players connect to (default %d)\n",DEFAULT_PORT);
+   fprintf (stderr,"  -w <port>     Port spectators connect to (default %d)\n",DEFAULT_WATCHPORT);
+   fprintf (stderr,"  -t <threads>  Number of threads (default: one per CPU)\n");
+   fprintf (stderr,"  -l <level>    Starting level of every game (%d-%d)\n",MINLEVEL,MAXLEVEL);
+   fprintf (stderr,"  -n            Draw next shape\n");
+   fprintf (stderr,"  -d            Draw vertical dotted lines\n");
+   fprintf (stderr,"  -b <char>     Use this character to draw blocks instead of spaces\n");
+   fprintf (stderr,"  -s            Draw shadow of shape\n");
+   fprintf (stderr,"  -T <file>     Write a record of every piece played to file (CSV if it ends in .csv)\n");
+   exit (EXIT_FAILURE);
+}
+
+static void parse_options (int argc,char *argv[])
+{
+   int i = 1;
+   while (i < argc)
+	 {
+		if (strcmp (argv[i],"-a") == 0 && i + 1 < argc)
+		  address = argv[++i];
+		else if (strcmp (argv[i],"-p") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&port,argv[++i]) || port < 1 || port > 65535) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-w") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&watchport,argv[++i]) || watchport < 1 || watchport > 65535) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-t") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&numthreads,argv[++i]) || numthreads < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-l") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&options.level,argv[++i]) || options.level < MINLEVEL || options.level > MAXLEVEL) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-n") == 0)
+		  options.shownext = TRUE;
+		else if (strcmp (argv[i],"-d") == 0)
+		  options.dottedlines = TRUE;
+		else if (strcmp (argv[i],"-b") == 0 && i + 1 < argc && argv[i + 1][0])
+		  options.blockchar = argv[++i][0];
+		else if (strcmp (argv[i],"-s") == 0)
+		  options.shadow = TRUE;
+		else if (strcmp (argv[i],"-T") == 0 && i + 1 < argc)
+		  {
+			 if (!telemetry_open (argv[++i])) die (argv[i]);
+		  }
+		else
+		  showhelp ();
+		i++;
+	 }
+}
+
+int main (int argc,char *argv[])
+{
+   pthread_t thread;
+   int i;
+   rand_init ();
+   options.level = MINLEVEL;
+   options.blockchar = ' ';
+   parse_options (argc,argv);
+   if (!numthreads && (numthreads = sysconf (_SC_NPROCESSORS_ONLN)) < 1) numthreads = 1;
+   signal (SIGPIPE,SIG_IGN);
+#ifdef PROFILE
+   signal (SIGINT,stop);
+   signal (SIGTERM,stop);
+#endif
+   raiselimit ();
+   io_server = io_ansi;
+   io_server.name = "server";
+   io_server.init = server_init;
+   io_server.close = server_close;
+   io_server.getkey = server_getch;
+   io_server.settimeout = server_timeout;
+   io_server.flush = server_flush;
+   io_use (&io_server);
+   /* Bind all sockets first, so we fail before serving anyone */
+   if ((threads = calloc (numthreads,sizeof (thread_t))) == NULL) die ("calloc");
+   for (i = 0; i < numthreads; i++)
+	 {
+		if ((threads[i].epfd = epoll_create1 (EPOLL_CLOEXEC)) < 0) die ("epoll_create1");
+		threads[i].players.fd = listensocket (port);
+		threads[i].players.kind = WATCH_PLAYERS;
+		threads[i].spectators.fd = listensocket (watchport);
+		threads[i].spectators.kind = WATCH_SPECTATORS;
+		if ((threads[i].handoff.fd = eventfd (0,EFD_NONBLOCK | EFD_CLOEXEC)) < 0) die ("eventfd");
+		threads[i].handoff.kind = WATCH_HANDOFF;
+		pthread_mutex_init (&threads[i].lock,NULL);
+	 }
+   for (i = 1; i < numthreads; i++)
+	 if ((errno = pthread_create (&thread,NULL,serve,&threads[i])) != 0) die ("pthread_create");
+   serve (&threads[0]);
+   exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,259 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Snapshots of games in progress, small enough to be saved every time
+ * a shape lands. The blocks on the board are packed two to a byte; the
+ * shape, its shadow and everything else fit in a fixed header.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "typedefs.h"
+#include "engine.h"
+#include "game.h"
+#include "snapshot.h"
+
+/*
+ * Macros
+ */
+
+/* Magic number and version at the start of a snapshot */
+#define SNAPSHOT_MAGIC		"TINTSAVE"
+#define SNAPSHOT_VERSION	1
+
+/* Bits in the flags byte */
+#define FLAG_SHOWNEXT		1
+#define FLAG_DOTTEDLINES	2
+#define FLAG_SHADOW			4
+
+/* Columns and rows of the board inside the walls */
+#define PLAYCOLS (NUMCOLS - 3)
+#define PLAYROWS (NUMROWS - 2)
+
+/* Offsets of the fields */
+#define S_VERSION		8
+#define S_FLAGS			9
+#define S_LEVEL			10
+#define S_CURSHAPE		11
+#define S_NEXTSHAPE		12
+#define S_ORIENTATION	13
+#define S_CURX			14
+#define S_CURY			15
+#define S_SHADOWX		16
+#define S_SHADOWY		17
+#define S_BAG			18
+#define S_BAGITERATOR	(S_BAG + NUMSHAPES)
+#define S_RNG			(S_BAGITERATOR + 4)
+#define S_SCORE			(S_RNG + 8)
+#define S_STATUS		(S_SCORE + 4)
+#define S_SHAPECOUNT	(S_STATUS + 6 * 4)
+#define S_BOARD			(S_SHAPECOUNT + NUMSHAPES * 4)
+#define S_CRC			(S_BOARD + (PLAYCOLS * PLAYROWS + 1) / 2)
+
+#if S_CRC + 4 != SNAPSHOTSIZE
+#error SNAPSHOTSIZE does not match the fields
+#endif
+
+/* Permissions of a saved game */
+#define SNAPSHOTMODE 0600
+
+/*
+ * Encoding
+ */
+
+static uint32_t get32 (const unsigned char *p)
+{
+   return ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+}
+
+static void put32 (unsigned char *p,uint32_t value)
+{
+   p[0] = value;
+   p[1] = value >> 8;
+   p[2] = value >> 16;
+   p[3] = value >> 24;
+}
+
+static uint64_t get64 (const unsigned char *p)
+{
+   return ((uint64_t) get32 (p + 4) << 32 | get32 (p));
+}
+
+static void put64 (unsigned char *p,uint64_t value)
+{
+   put32 (p,value);
+   put32 (p + 4,value >> 32);
+}
+
+/* CRC-32 (the one zlib uses) of len bytes */
+static uint32_t crc32 (const unsigned char *p,size_t len)
+{
+   uint32_t crc = 0xffffffff;
+   int i;
+   while (len--)
+	 {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++) crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+	 }
+   return (~crc);
+}
+
+/* Where block i of the board goes in a snapshot, and where it comes from */
+#define CELL(engine,i) (engine)->board[1 + (i) % PLAYCOLS][(i) / PLAYCOLS]
+
+/* Write a snapshot of the game to buf */
+void snapshot_encode (const game_t *game,unsigned char *buf)
+{
+   const engine_t *engine = &game->engine;
+   int i;
+   memset (buf,0,SNAPSHOTSIZE);
+   memcpy (buf,SNAPSHOT_MAGIC,S_VERSION);
+   buf[S_VERSION] = SNAPSHOT_VERSION;
+   buf[S_FLAGS] = (game->shownext ? FLAG_SHOWNEXT : 0) | (game->dottedlines ? FLAG_DOTTEDLINES : 0) | (engine->shadow ? FLAG_SHADOW : 0);
+   buf[S_LEVEL] = game->level;
+   buf[S_CURSHAPE] = engine->curshape;
+   buf[S_NEXTSHAPE] = engine->nextshape;
+   buf[S_ORIENTATION] = engine->orientation;
+   buf[S_CURX] = engine->curx;
+   buf[S_CURY] = engine->cury;
+   buf[S_SHADOWX] = engine->curx_shadow;
+   buf[S_SHADOWY] = engine->cury_shadow;
+   for (i = 0; i < NUMSHAPES; i++) buf[S_BAG + i] = engine->bag[i];
+   put32 (buf + S_BAGITERATOR,engine->bag_iterator);
+   put64 (buf + S_RNG,engine->rng);
+   put32 (buf + S_SCORE,engine->score);
+   put32 (buf + S_STATUS,engine->status.moves);
+   put32 (buf + S_STATUS + 4,engine->status.rotations);
+   put32 (buf + S_STATUS + 8,engine->status.dropcount);
+   put32 (buf + S_STATUS + 12,engine->status.efficiency);
+   put32 (buf + S_STATUS + 16,engine->status.droppedlines);
+   put32 (buf + S_STATUS + 20,engine->status.currentdroppedlines);
+   for (i = 0; i < NUMSHAPES; i++) put32 (buf + S_SHAPECOUNT + i * 4,game->shapecount[i]);
+   for (i = 0; i < PLAYCOLS * PLAYROWS; i++) buf[S_BOARD + i / 2] |= CELL (engine,i) << (i & 1) * 4;
+   put32 (buf + S_CRC,crc32 (buf,S_CRC));
+}
+
+/* Check that buf holds a snapshot we can carry on with */
+static bool valid (const unsigned char *buf)
+{
+   int i,seen = 0;
+   if (memcmp (buf,SNAPSHOT_MAGIC,S_VERSION) != 0 || buf[S_VERSION] != SNAPSHOT_VERSION || get32 (buf + S_CRC) != crc32 (buf,S_CRC)) return (FALSE);
+   if (buf[S_LEVEL] < MINLEVEL || buf[S_LEVEL] > MAXLEVEL || buf[S_CURSHAPE] >= NUMSHAPES || buf[S_NEXTSHAPE] >= NUMSHAPES) return (FALSE);
+   if (buf[S_ORIENTATION] < FIRSTORIENTATION[buf[S_CURSHAPE]] || buf[S_ORIENTATION] >= FIRSTORIENTATION[buf[S_CURSHAPE] + 1]) return (FALSE);
+   /* The shape and its shadow have to be inside the walls, where their blocks can't reach past the board */
+   if (buf[S_CURX] < 1 || buf[S_CURX] > PLAYCOLS || buf[S_CURY] < 1 || buf[S_CURY] >= PLAYROWS) return (FALSE);
+   if (buf[S_SHADOWX] < 1 || buf[S_SHADOWX] > PLAYCOLS || buf[S_SHADOWY] < 1 || buf[S_SHADOWY] >= PLAYROWS) return (FALSE);
+   /* The bag holds every shape once */
+   for (i = 0; i < NUMSHAPES; i++) if (buf[S_BAG + i] < NUMSHAPES) seen |= 1 << buf[S_BAG + i];
+   if (seen != (1 << NUMSHAPES) - 1 || (int32_t) get32 (buf + S_BAGITERATOR) < 1) return (FALSE);
+   for (i = 0; i < NUMSHAPES; i++) if ((int32_t) get32 (buf + S_SHAPECOUNT + i * 4) < 0) return (FALSE);
+   /* Blocks are black or one of the seven colours */
+   for (i = 0; i < PLAYCOLS * PLAYROWS; i++) if ((buf[S_BOARD + i / 2] >> (i & 1) * 4 & 15) > COLOR_WHITE) return (FALSE);
+   return (TRUE);
+}
+
+/* Carry on with the game in buf */
+bool snapshot_decode (game_t *game,const unsigned char *buf)
+{
+   engine_t *engine = &game->engine;
+   int i;
+   if (!valid (buf)) return (FALSE);
+   game->shownext = (buf[S_FLAGS] & FLAG_SHOWNEXT) != 0;
+   game->dottedlines = (buf[S_FLAGS] & FLAG_DOTTEDLINES) != 0;
+   game->shadow = engine->shadow = (buf[S_FLAGS] & FLAG_SHADOW) != 0;
+   game->level = buf[S_LEVEL];
+   engine->curshape = buf[S_CURSHAPE];
+   engine->nextshape = buf[S_NEXTSHAPE];
+   engine->orientation = buf[S_ORIENTATION];
+   engine->curx = buf[S_CURX];
+   engine->cury = buf[S_CURY];
+   engine->curx_shadow = buf[S_SHADOWX];
+   engine->cury_shadow = buf[S_SHADOWY];
+   for (i = 0; i < NUMSHAPES; i++) engine->bag[i] = buf[S_BAG + i];
+   engine->bag_iterator = get32 (buf + S_BAGITERATOR);
+   engine->rng = get64 (buf + S_RNG);
+   engine->score = get32 (buf + S_SCORE);
+   engine->status.moves = get32 (buf + S_STATUS);
+   engine->status.rotations = get32 (buf + S_STATUS + 4);
+   engine->status.dropcount = get32 (buf + S_STATUS + 8);
+   engine->status.efficiency = get32 (buf + S_STATUS + 12);
+   engine->status.droppedlines = get32 (buf + S_STATUS + 16);
+   engine->status.currentdroppedlines = get32 (buf + S_STATUS + 20);
+   for (i = 0; i < NUMSHAPES; i++) game->shapecount[i] = get32 (buf + S_SHAPECOUNT + i * 4);
+   for (i = 0; i < PLAYCOLS * PLAYROWS; i++) CELL (engine,i) = buf[S_BOARD + i / 2] >> (i & 1) * 4 & 15;
+   engine_rebuild (engine);
+   return (TRUE);
+}
+
+/*
+ * Files
+ */
+
+/* Save a snapshot of the game to a file */
+bool snapshot_save (const game_t *game,const char *filename)
+{
+   unsigned char buf[SNAPSHOTSIZE];
+   char tmp[strlen (filename) + 8];
+   ssize_t result;
+   int fd;
+   bool ok;
+   snapshot_encode (game,buf);
+   snprintf (tmp,sizeof (tmp),"%s.XXXXXX",filename);
+   if ((fd = mkstemp (tmp)) < 0) return (FALSE);
+   while ((result = write (fd,buf,SNAPSHOTSIZE)) < 0 && errno == EINTR) ;
+   /* No fsync (): this runs every time a shape lands, and the rename alone */
+   /* is enough to survive the game crashing or being killed */
+   ok = result == SNAPSHOTSIZE && fchmod (fd,SNAPSHOTMODE) == 0;
+   /* Closed once whatever happened, since a failed close () may have closed it anyway */
+   if (close (fd) != 0) ok = FALSE;
+   if (ok && rename (tmp,filename) == 0) return (TRUE);
+   unlink (tmp);
+   return (FALSE);
+}
+
+/* Carry on with the game saved in a file */
+bool snapshot_load (game_t *game,const char *filename)
+{
+   unsigned char buf[SNAPSHOTSIZE + 1];
+   ssize_t result;
+   int fd;
+   if ((fd = open (filename,O_RDONLY)) < 0) return (FALSE);
+   while ((result = read (fd,buf,sizeof (buf))) < 0 && errno == EINTR) ;
+   close (fd);
+   return (result == SNAPSHOTSIZE && snapshot_decode (game,buf));
+}
@@ -0,0 +1,75 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "game.h"			/* game_t */
+
+/*
+ * Macros
+ */
+
+/* Size of a snapshot in bytes */
+#define SNAPSHOTSIZE 202
+
+/*
+ * Functions
+ */
+
+/*
+ * Write everything needed to carry on with a game (the board, the
+ * shape, the bag, the random number generator, the score, the status,
+ * the level, the shape counts and the options that change the score)
+ * to buf, which must hold SNAPSHOTSIZE bytes. All numbers are stored
+ * little endian and the snapshot ends in a CRC-32 of the rest
+ */
+void snapshot_encode (const game_t *game,unsigned char *buf);
+
+/*
+ * Carry on with the game in buf. The game must have been initialized
+ * with game_init (). Returns FALSE, leaving the game alone, if the
+ * snapshot is damaged or doesn't make sense
+ */
+bool snapshot_decode (game_t *game,const unsigned char *buf);
+
+/*
+ * Save a snapshot of the game to a file. It is written next to the
+ * file and renamed over it, so the file always holds a whole snapshot,
+ * even if we're killed halfway. Returns FALSE if it couldn't be written
+ */
+bool snapshot_save (const game_t *game,const char *filename);
+
+/*
+ * Carry on with the game saved in a file. Returns FALSE if there is
+ * no such file or the snapshot in it can't be used
+ */
+bool snapshot_load (game_t *game,const char *filename);
+
+#endif	/* #ifndef SNAPSHOT_H */
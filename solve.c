@@ -0,0 +1,622 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tint-solve: looks for a perfect clear (an empty board) from a given
+ * board and queue of shapes, and the fewest key presses that put each
+ * shape where it goes (finesse). The board is kept as one 64-bit mask
+ * of the rows still to be cleared, so placing a shape, clearing lines
+ * and checking that every pocket of empty cells can still be filled
+ * with whole shapes are a few shifts each. Positions that turned out
+ * not to lead anywhere are remembered in a hash set. Every placement of
+ * the first shape is searched as a separate job in a work-stealing
+ * pool; the solution of the first one (in the order placements are
+ * found) that has one is used, so the answer doesn't depend on the
+ * number of threads.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "pool.h"
+
+/*
+ * Macros
+ */
+
+/* Playing field, without the walls */
+#define PLAYCOLS (NUMCOLS - 3)
+#define PLAYROWS (NUMROWS - 2)
+#define FULLROW ((1ULL << PLAYCOLS) - 1)
+
+/* Where shapes appear */
+#define SPAWNX 5
+#define SPAWNY 1
+
+/* Most rows to clear, so that they fit in 64 bits */
+#define MAXHEIGHT 6
+
+/* Left and right column of every row */
+#define LEFTCOL 0x0004010040100401ULL
+#define RIGHTCOL (LEFTCOL << (PLAYCOLS - 1))
+
+/* Cells in the bottom height rows */
+#define AREA(height) ((1ULL << ((height) * PLAYCOLS)) - 1)
+
+/* Shapes in the queue */
+#define MAXQUEUE 32
+
+/* Positions of a shape: orientation (within its type), row and column */
+#define STATES (4 * PLAYROWS * NUMCOLS)
+#define STATE(k,x,y) (((k) * PLAYROWS + (y)) * NUMCOLS + (x))
+
+/* Positions remembered by each thread before it starts over */
+#define MEMOSIZE (1 << 18)
+
+/* Most places a shape can come to rest */
+#define MAXPLACEMENTS (4 * (MAXHEIGHT + 3) * PLAYCOLS)
+
+/* Holding the down key until the shape stops, a key press like the actions */
+#define ACTION_HOLDDOWN (ACTION_DOWN + 1)
+
+/* Keeps threads' scratch space apart in the cache */
+#define CACHELINE 64
+
+/*
+ * Type definitions
+ */
+
+/* The rows still to be cleared */
+typedef struct
+{
+   uint64_t bits;			/* bit PLAYCOLS * r + c is column c + 1 of row r from the bottom */
+   int height;				/* number of rows */
+} field_t;
+
+/* Where a shape comes to rest, in board coordinates */
+typedef struct
+{
+   int orientation,x,y;
+} placement_t;
+
+/* Everywhere a shape can be moved to, and how */
+typedef struct
+{
+   unsigned char presses[STATES];		/* 0 if it can't get there */
+   short from[STATES];					/* position before the last key */
+   unsigned char action[STATES];		/* last key */
+} reach_t;
+
+/* What a thread searches with */
+typedef struct
+{
+   uint64_t *seen;			/* positions without a perfect clear */
+   int count;
+   unsigned long positions;
+} __attribute__ ((aligned (CACHELINE))) scratch_t;
+
+typedef struct solver_struct solver_t;
+
+/* Everything after one placement of the first shape (a job in the pool) */
+typedef struct
+{
+   solver_t *solver;
+   int branch;
+   field_t field;
+   placement_t path[MAXQUEUE];
+} branch_t;
+
+struct solver_struct
+{
+   int queue[MAXQUEUE];
+   int length;
+   int solved;				/* first branch with a solution so far */
+   scratch_t *scratch;		/* one for every thread */
+};
+
+enum { FAILED, FOUND, ABORTED };
+
+/*
+ * Global variables
+ */
+
+/* Shape types by letter */
+static const char LETTERS[] = "ZSTOLJI";
+
+/* Keys in tint for every action */
+static const char *KEYS[] = { "j", "K", "k", "l", "space", "down", "hold down" };
+
+static int numthreads,lines;
+static bool finesse;
+
+/*
+ * Functions
+ */
+
+static void die (const char *msg)
+{
+   fprintf (stderr,"tint-solve: %s: %s\n",msg,strerror (errno));
+   exit (EXIT_FAILURE);
+}
+
+/*
+ * Fields
+ */
+
+/* Check if orientation o fits at (x,y) */
+static bool fits (const field_t *field,int o,int x,int y)
+{
+   int i,cx,cy,r;
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		cx = x + ORIENTATIONS[o].block[i].x;
+		cy = y + ORIENTATIONS[o].block[i].y;
+		if (cx < 1 || cx > PLAYCOLS || cy < 0 || cy >= PLAYROWS) return (FALSE);
+		r = PLAYROWS - 1 - cy;
+		if (r < field->height && (field->bits >> (r * PLAYCOLS + cx - 1) & 1)) return (FALSE);
+	 }
+   return (TRUE);
+}
+
+/* Remove full rows */
+static void clear (field_t *field)
+{
+   uint64_t row,bits = 0;
+   int r,height = 0;
+   for (r = 0; r < field->height; r++)
+	 if ((row = field->bits >> (r * PLAYCOLS) & FULLROW) != FULLROW)
+	   bits |= row << (height++ * PLAYCOLS);
+   field->bits = bits;
+   field->height = height;
+}
+
+/* Put a shape down and clear lines. Returns FALSE if it sticks out above the rows to clear */
+static bool place (field_t *field,const placement_t *placement)
+{
+   const block_t *block = ORIENTATIONS[placement->orientation].block;
+   int i,r;
+   for (i = 0; i < NUMBLOCKS; i++)
+	 {
+		if ((r = PLAYROWS - 1 - placement->y - block[i].y) >= field->height) return (FALSE);
+		field->bits |= 1ULL << (r * PLAYCOLS + placement->x + block[i].x - 1);
+	 }
+   clear (field);
+   return (TRUE);
+}
+
+/* Check that every pocket of empty cells can still take whole shapes */
+static bool promising (const field_t *field)
+{
+   uint64_t empty = ~field->bits & AREA (field->height),region,grown;
+   while (empty)
+	 {
+		region = empty & -empty;
+		do
+		  {
+			 grown = region;
+			 region = (region | (region << 1 & ~LEFTCOL) | (region >> 1 & ~RIGHTCOL) | region << PLAYCOLS | region >> PLAYCOLS) & empty;
+		  }
+		while (region != grown);
+		if (__builtin_popcountll (region) % NUMBLOCKS) return (FALSE);
+		empty &= ~region;
+	 }
+   return (TRUE);
+}
+
+/*
+ * Moving shapes
+ */
+
+/* Find the fewest key presses to every position a shape of type can get to */
+static bool explore (const field_t *field,int type,reach_t *reach)
+{
+   static const int actions[] = { ACTION_LEFT, ACTION_RIGHT, ACTION_ROTATE_COUNTERCLOCKWISE, ACTION_ROTATE_CLOCKWISE, ACTION_HOLDDOWN, ACTION_DOWN };
+   int first = FIRSTORIENTATION[type],n = FIRSTORIENTATION[type + 1] - first;
+   short queue[STATES];
+   int head = 0,tail = 0,s,t,i,k,x,y;
+   memset (reach->presses,0,sizeof (reach->presses));
+   if (!fits (field,first,SPAWNX,SPAWNY)) return (FALSE);
+   s = STATE (0,SPAWNX,SPAWNY);
+   reach->presses[s] = 1;
+   queue[tail++] = s;
+   while (head < tail)
+	 {
+		s = queue[head++];
+		for (i = 0; i < (int) (sizeof (actions) / sizeof (actions[0])); i++)
+		  {
+			 k = s / (PLAYROWS * NUMCOLS);
+			 y = s / NUMCOLS % PLAYROWS;
+			 x = s % NUMCOLS;
+			 switch (actions[i])
+			   {
+				case ACTION_LEFT:
+				  x--;
+				  break;
+				case ACTION_RIGHT:
+				  x++;
+				  break;
+				case ACTION_DOWN:
+				  y++;
+				  break;
+				case ACTION_HOLDDOWN:
+				  while (fits (field,first + k,x,y + 1)) y++;
+				  break;
+				default:
+				  /* Shapes with two orientations flip either way */
+				  if (n == 1) continue;
+				  k = (k + (actions[i] == ACTION_ROTATE_CLOCKWISE || n == 2 ? 1 : n - 1)) % n;
+			   }
+			 if (!fits (field,first + k,x,y) || reach->presses[t = STATE (k,x,y)]) continue;
+			 reach->presses[t] = reach->presses[s] + 1;
+			 reach->from[t] = s;
+			 reach->action[t] = actions[i];
+			 queue[tail++] = t;
+		  }
+	 }
+   return (TRUE);
+}
+
+/*
+ * Every place a shape of type can come to rest. Above the rows to clear
+ * a shape can go anywhere, so this only floods the rows it can reach
+ * from there, a row of columns at a time
+ */
+static int placements (const field_t *field,int type,placement_t *list)
+{
+   int first = FIRSTORIENTATION[type],n = FIRSTORIENTATION[type + 1] - first;
+   int top = PLAYROWS - field->height - 3,k,x,y,count = 0;
+   unsigned int fit[4][MAXHEIGHT + 4] = { { 0 } },reach[4][MAXHEIGHT + 4] = { { 0 } },old,spread;
+   bool changed;
+   for (k = 0; k < n; k++)
+	 for (y = top; y < PLAYROWS; y++)
+	   for (x = 1; x <= PLAYCOLS; x++)
+		 if (fits (field,first + k,x,y)) fit[k][y - top] |= 1 << x;
+   /* Every way up there is clear */
+   for (k = 0; k < n; k++) reach[k][0] = fit[k][0];
+   do
+	 {
+		changed = FALSE;
+		for (y = 0; y < PLAYROWS - top; y++)
+		  for (k = 0; k < n; k++)
+			{
+			   old = reach[k][y];
+			   if (y) reach[k][y] |= reach[k][y - 1] & fit[k][y];
+			   /* Rotations either way, if there are any */
+			   reach[k][y] |= (reach[(k + 1) % n][y] | reach[(k + n - 1) % n][y]) & fit[k][y];
+			   do
+				 {
+					spread = reach[k][y];
+					reach[k][y] |= (spread << 1 | spread >> 1) & fit[k][y];
+				 }
+			   while (reach[k][y] != spread);
+			   if (reach[k][y] != old) changed = TRUE;
+			}
+	 }
+   while (changed);
+   for (k = 0; k < n; k++)
+	 for (y = 0; y < PLAYROWS - top; y++)
+	   for (x = 1; x <= PLAYCOLS; x++)
+		 if ((reach[k][y] & ~(y + 1 < PLAYROWS - top ? fit[k][y + 1] : 0)) >> x & 1)
+		   {
+			  list[count].orientation = first + k;
+			  list[count].x = x;
+			  list[count].y = top + y;
+			  count++;
+		   }
+   return (count);
+}
+
+/* The fewest keys that put a shape of type where placement says. Returns how many there are */
+static int route (const field_t *field,int type,const placement_t *placement,int *keys)
+{
+   reach_t reach;
+   int s,best = -1,n,k,x,y;
+   explore (field,type,&reach);
+   for (s = 0; s < STATES; s++)
+	 if (reach.presses[s] && (best < 0 || reach.presses[s] < reach.presses[best]))
+	   {
+		  k = s / (PLAYROWS * NUMCOLS);
+		  x = s % NUMCOLS;
+		  for (y = s / NUMCOLS % PLAYROWS; fits (field,FIRSTORIENTATION[type] + k,x,y + 1); y++) ;
+		  if (FIRSTORIENTATION[type] + k == placement->orientation && x == placement->x && y == placement->y) best = s;
+	   }
+   /* Dropping is one more key */
+   n = reach.presses[best];
+   keys[n - 1] = ACTION_DROP;
+   for (s = best; reach.presses[s] > 1; s = reach.from[s])
+	 keys[reach.presses[s] - 2] = reach.action[s];
+   return (n);
+}
+
+/*
+ * Search
+ */
+
+/* Position number of a field, never 0 */
+static uint64_t key (const field_t *field)
+{
+   return (((field->bits << 3) | field->height) + 1);
+}
+
+static uint64_t *slot (scratch_t *scratch,uint64_t k)
+{
+   uint64_t h = k * 0x9e3779b97f4a7c15ULL;
+   uint64_t *s = &scratch->seen[(h >> 32) & (MEMOSIZE - 1)];
+   while (*s && *s != k) if (++s == scratch->seen + MEMOSIZE) s = scratch->seen;
+   return (s);
+}
+
+/* Remember that a field doesn't lead to a perfect clear */
+static void forget (scratch_t *scratch,const field_t *field)
+{
+   /* Start over before the hash set gets slow */
+   if (scratch->count >= MEMOSIZE / 4 * 3)
+	 {
+		memset (scratch->seen,0,MEMOSIZE * sizeof (uint64_t));
+		scratch->count = 0;
+	 }
+   *slot (scratch,key (field)) = key (field);
+   scratch->count++;
+}
+
+/* Place the shapes from queue[index] on until the field is empty */
+static int search (solver_t *solver,scratch_t *scratch,const field_t *field,int index,branch_t *branch)
+{
+   placement_t list[MAXPLACEMENTS];
+   field_t child;
+   int i,n,result;
+   if (!field->height) return (FOUND);
+   if (index == solver->length) return (FAILED);
+   /* Someone found one first */
+   if (__atomic_load_n (&solver->solved,__ATOMIC_RELAXED) < branch->branch) return (ABORTED);
+   if (*slot (scratch,key (field))) return (FAILED);
+   scratch->positions++;
+   n = placements (field,solver->queue[index],list);
+   for (i = 0; i < n; i++)
+	 {
+		child = *field;
+		if (!place (&child,&list[i]) || !promising (&child)) continue;
+		if ((result = search (solver,scratch,&child,index + 1,branch)) == FOUND) branch->path[index] = list[i];
+		if (result != FAILED) return (result);
+	 }
+   forget (scratch,field);
+   return (FAILED);
+}
+
+/* Search one branch (a job in the pool) */
+static void follow (void *arg)
+{
+   branch_t *branch = arg;
+   solver_t *solver = branch->solver;
+   int solved;
+   if (search (solver,&solver->scratch[pool_worker ()],&branch->field,1,branch) != FOUND) return;
+   solved = __atomic_load_n (&solver->solved,__ATOMIC_RELAXED);
+   while (branch->branch < solved && !__atomic_compare_exchange_n (&solver->solved,&solved,branch->branch,FALSE,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) ;
+}
+
+/* Find a perfect clear of field. Returns the number of shapes in it, 0 if there isn't one */
+static int solve (pool_t *pool,solver_t *solver,const field_t *field,placement_t *path)
+{
+   placement_t *list;
+   branch_t *branch;
+   int i,n,count = 0;
+   if ((list = malloc (MAXPLACEMENTS * sizeof (placement_t))) == NULL || (branch = malloc (MAXPLACEMENTS * sizeof (branch_t))) == NULL) die ("malloc");
+   n = placements (field,solver->queue[0],list);
+   for (i = 0; i < n; i++)
+	 {
+		branch[count].field = *field;
+		if (!place (&branch[count].field,&list[i]) || !promising (&branch[count].field)) continue;
+		branch[count].solver = solver;
+		branch[count].branch = count;
+		branch[count].path[0] = list[i];
+		count++;
+	 }
+   solver->solved = count;
+   /* What failed at another height had a different queue ahead of it */
+   for (i = 0; i < numthreads; i++)
+	 if (solver->scratch[i].count)
+	   {
+		  memset (solver->scratch[i].seen,0,MEMOSIZE * sizeof (uint64_t));
+		  solver->scratch[i].count = 0;
+	   }
+   /* Threads take their newest job first, so queue the first branch last */
+   for (i = count - 1; i >= 0; i--) pool_submit (pool,follow,&branch[i]);
+   pool_wait (pool);
+   n = 0;
+   if (solver->solved < count)
+	 {
+		memcpy (path,branch[solver->solved].path,sizeof (branch->path));
+		n = (field->height * PLAYCOLS - __builtin_popcountll (field->bits)) / NUMBLOCKS;
+	 }
+   free (branch);
+   free (list);
+   return (n);
+}
+
+/*
+ * Input & Output
+ */
+
+/* Read a board: rows of PLAYCOLS cells, '.' for empty ones, the last one at the bottom */
+static void readboard (const char *filename,field_t *field)
+{
+   char buf[256];
+   uint64_t row;
+   int c,n = 0;
+   FILE *fp = strcmp (filename,"-") == 0 ? stdin : fopen (filename,"r");
+   if (fp == NULL) die (filename);
+   field->bits = 0;
+   while (fgets (buf,sizeof (buf),fp) != NULL)
+	 {
+		buf[strcspn (buf,"\r\n")] = '\0';
+		if (buf[0] == '\0' || buf[0] == ';') continue;
+		if (strlen (buf) != PLAYCOLS || n == MAXHEIGHT)
+		  {
+			 fprintf (stderr,"tint-solve: %s: rows must be %d cells wide, and there may be up to %d of them\n",filename,PLAYCOLS,MAXHEIGHT);
+			 exit (EXIT_FAILURE);
+		  }
+		for (row = 0, c = 0; c < PLAYCOLS; c++)
+		  if (buf[c] != '.') row |= 1ULL << c;
+		field->bits = field->bits << PLAYCOLS | row;
+		n++;
+	 }
+   if (fp != stdin) fclose (fp);
+   field->height = n;
+   clear (field);
+   /* Only rows with something in them count */
+   while (field->height && !(field->bits >> ((field->height - 1) * PLAYCOLS))) field->height--;
+}
+
+static void readqueue (const char *str,solver_t *solver)
+{
+   const char *letter;
+   for (solver->length = 0; *str; str++)
+	 {
+		if ((letter = strchr (LETTERS,toupper ((unsigned char) *str))) == NULL || solver->length == MAXQUEUE)
+		  {
+			 fprintf (stderr,"tint-solve: the queue is made of up to %d of the letters %s\n",MAXQUEUE,LETTERS);
+			 exit (EXIT_FAILURE);
+		  }
+		solver->queue[solver->length++] = letter - LETTERS;
+	 }
+}
+
+static void printplacement (const field_t *field,int type,const placement_t *placement)
+{
+   int keys[STATES];
+   int i,n = route (field,type,placement,keys);
+   printf ("%c turned %d at x %d, y %d:",LETTERS[type],ORIENTATIONS[placement->orientation].rotations,placement->x,placement->y);
+   for (i = 0; i < n; i++) printf (" %s",KEYS[keys[i]]);
+   printf (" (%d key%s)\n",n,n == 1 ? "" : "s");
+}
+
+/*
+ * Options
+ */
+
+static void showhelp ()
+{
+   fprintf (stderr,"USAGE: tint-solve [-h] [-l lines] [-t threads] [-f] board queue\n");
+   fprintf (stderr,"  -h            Show this help message\n");
+   fprintf (stderr,"  -l <lines>    Clear this many lines (default: as few as the board and queue allow)\n");
+   fprintf (stderr,"  -t <threads>  Number of threads (default: one per CPU)\n");
+   fprintf (stderr,"  -f            Show the fewest keys for every placement of the first shape instead\n");
+   fprintf (stderr,"  board         File with rows of %d cells, '.' for empty ones, or - for standard input\n",PLAYCOLS);
+   fprintf (stderr,"  queue         Shapes to place, in order, like TILJSZO\n");
+   exit (EXIT_FAILURE);
+}
+
+static int parse_options (int argc,char *argv[])
+{
+   int i = 1;
+   while (i < argc && argv[i][0] == '-' && argv[i][1] != '\0')
+	 {
+		if (strcmp (argv[i],"-l") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&lines,argv[++i]) || lines < 1 || lines > MAXHEIGHT) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-t") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&numthreads,argv[++i]) || numthreads < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-f") == 0)
+		  finesse = TRUE;
+		else
+		  showhelp ();
+		i++;
+	 }
+   if (argc - i != 2) showhelp ();
+   return (i);
+}
+
+int main (int argc,char *argv[])
+{
+   solver_t solver;
+   field_t board,field;
+   placement_t path[MAXQUEUE],*list;
+   pool_t *pool;
+   unsigned long positions = 0;
+   long long started;
+   int i,n,empty;
+   i = parse_options (argc,argv);
+   readboard (argv[i],&board);
+   readqueue (argv[i + 1],&solver);
+   if (!solver.length) showhelp ();
+   if (finesse)
+	 {
+		if ((list = malloc (MAXPLACEMENTS * sizeof (placement_t))) == NULL) die ("malloc");
+		n = placements (&board,solver.queue[0],list);
+		for (i = 0; i < n; i++) printplacement (&board,solver.queue[0],&list[i]);
+		free (list);
+		exit (EXIT_SUCCESS);
+	 }
+   if (!numthreads && (numthreads = sysconf (_SC_NPROCESSORS_ONLN)) < 1) numthreads = 1;
+   if ((pool = pool_new (numthreads)) == NULL) die ("pool_new");
+   if ((solver.scratch = aligned_alloc (CACHELINE,numthreads * sizeof (scratch_t))) == NULL) die ("aligned_alloc");
+   for (i = 0; i < numthreads; i++)
+	 {
+		if ((solver.scratch[i].seen = calloc (MEMOSIZE,sizeof (uint64_t))) == NULL) die ("calloc");
+		solver.scratch[i].count = 0;
+		solver.scratch[i].positions = 0;
+	 }
+   started = microseconds ();
+   /* Try every height the shapes can fill exactly */
+   for (n = 0, field = board, field.height = lines ? lines : board.height; !n && field.height <= (lines ? lines : MAXHEIGHT); field.height++)
+	 {
+		if (field.height < board.height || !field.height) continue;
+		empty = field.height * PLAYCOLS - __builtin_popcountll (field.bits);
+		if (empty % NUMBLOCKS || empty / NUMBLOCKS > solver.length || !promising (&field)) continue;
+		n = solve (pool,&solver,&field,path);
+	 }
+   for (i = 0; i < numthreads; i++) positions += solver.scratch[i].positions;
+   if (!n)
+	 {
+		printf ("No perfect clear (%.1f ms, %lu positions)\n",(microseconds () - started) / 1e3,positions);
+		exit (EXIT_FAILURE);
+	 }
+   printf ("Perfect clear of %d lines with %d shapes (%.1f ms, %lu positions)\n",--field.height,n,(microseconds () - started) / 1e3,positions);
+   for (i = 0; i < n; i++)
+	 {
+		printf ("%3d. ",i + 1);
+		printplacement (&field,solver.queue[i],&path[i]);
+		place (&field,&path[i]);
+	 }
+   for (i = 0; i < numthreads; i++) free (solver.scratch[i].seen);
+   free (solver.scratch);
+   pool_free (pool);
+   exit (EXIT_SUCCESS);
+}
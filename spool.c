@@ -0,0 +1,183 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "typedefs.h"
+#include "spool.h"
+
+/*
+ * Macros
+ */
+
+/* Seconds between writes when little is happening */
+#define INTERVAL 1
+
+/*
+ * Type definitions
+ */
+
+struct spool_struct
+{
+   int fd;
+   size_t size;					/* of each buffer */
+   pthread_t writer;
+   pthread_mutex_t lock;		/* protects everything below */
+   pthread_cond_t wakeup;		/* a buffer is half full, or we're done */
+   char *buffers[2];			/* appended to while the other is being written */
+   char *pending;
+   size_t pendinglen;
+   bool finished;
+};
+
+/*
+ * Functions
+ */
+
+static void writeall (int fd,const char *buf,size_t len)
+{
+   ssize_t result;
+   while (len)
+	 {
+		if ((result = write (fd,buf,len)) < 0)
+		  {
+			 if (errno == EINTR) continue;
+			 return;
+		  }
+		buf += result;
+		len -= result;
+	 }
+}
+
+static void *writeloop (void *arg)
+{
+   spool_t *spool = arg;
+   struct timespec ts;
+   char *buf;
+   size_t len;
+   bool done;
+   pthread_mutex_lock (&spool->lock);
+   do
+	 {
+		if (!spool->finished && spool->pendinglen < spool->size / 2)
+		  {
+			 clock_gettime (CLOCK_REALTIME,&ts);
+			 ts.tv_sec += INTERVAL;
+			 pthread_cond_timedwait (&spool->wakeup,&spool->lock,&ts);
+		  }
+		done = spool->finished;
+		buf = spool->pending;
+		len = spool->pendinglen;
+		spool->pending = buf == spool->buffers[0] ? spool->buffers[1] : spool->buffers[0];
+		spool->pendinglen = 0;
+		pthread_mutex_unlock (&spool->lock);
+		writeall (spool->fd,buf,len);
+		pthread_mutex_lock (&spool->lock);
+	 }
+   while (!done);
+   pthread_mutex_unlock (&spool->lock);
+   return NULL;
+}
+
+/* Create the file and start writing to it */
+spool_t *spool_open (const char *filename,size_t size)
+{
+   spool_t *spool;
+   if ((spool = calloc (1,sizeof (spool_t))) == NULL) return (NULL);
+   spool->size = size;
+   if ((spool->buffers[0] = malloc (size)) == NULL || (spool->buffers[1] = malloc (size)) == NULL)
+	 {
+		free (spool->buffers[0]);
+		free (spool);
+		return (NULL);
+	 }
+   spool->pending = spool->buffers[0];
+   pthread_mutex_init (&spool->lock,NULL);
+   pthread_cond_init (&spool->wakeup,NULL);
+   if ((spool->fd = open (filename,O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,0644)) < 0 ||
+	   pthread_create (&spool->writer,NULL,writeloop,spool) != 0)
+	 {
+		if (spool->fd >= 0) close (spool->fd);
+		free (spool->buffers[0]);
+		free (spool->buffers[1]);
+		free (spool);
+		return (NULL);
+	 }
+   return (spool);
+}
+
+/* Make room for len bytes, keeping the buffer locked if there is */
+char *spool_reserve (spool_t *spool,size_t len)
+{
+   pthread_mutex_lock (&spool->lock);
+   if (spool->pendinglen + len > spool->size)
+	 {
+		pthread_mutex_unlock (&spool->lock);
+		return (NULL);
+	 }
+   return (spool->pending + spool->pendinglen);
+}
+
+/* Add what was put in the room made by spool_reserve () */
+void spool_commit (spool_t *spool,size_t len)
+{
+   spool->pendinglen += len;
+   if (spool->pendinglen >= spool->size / 2) pthread_cond_signal (&spool->wakeup);
+   pthread_mutex_unlock (&spool->lock);
+}
+
+/* Append len bytes */
+bool spool_write (spool_t *spool,const void *buf,size_t len)
+{
+   char *p;
+   if ((p = spool_reserve (spool,len)) == NULL) return (FALSE);
+   memcpy (p,buf,len);
+   spool_commit (spool,len);
+   return (TRUE);
+}
+
+/* Write what's left and free the spool */
+void spool_close (spool_t *spool)
+{
+   pthread_mutex_lock (&spool->lock);
+   spool->finished = TRUE;
+   pthread_cond_signal (&spool->wakeup);
+   pthread_mutex_unlock (&spool->lock);
+   pthread_join (spool->writer,NULL);
+   close (spool->fd);
+   free (spool->buffers[0]);
+   free (spool->buffers[1]);
+   free (spool);
+}
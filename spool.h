@@ -0,0 +1,79 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Buffered writer for files that are written while a game is going on.
+ * Callers append to one buffer while a thread writes the other to the
+ * file; the two swap buffers under a mutex, so callers never wait for
+ * the disk, only (briefly) for the pointer swap. When the file can't
+ * keep up, what doesn't fit in the buffer is refused instead of piling
+ * up.
+ */
+
+#include <stddef.h>			/* size_t */
+
+#include "typedefs.h"		/* bool */
+
+/*
+ * Type definitions
+ */
+
+typedef struct spool_struct spool_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Create (or truncate) a file and start the thread writing to it, with
+ * two buffers of size bytes. Returns NULL if something fails
+ */
+spool_t *spool_open (const char *filename,size_t size);
+
+/*
+ * Append len bytes. Returns FALSE if they don't fit in the buffer
+ */
+bool spool_write (spool_t *spool,const void *buf,size_t len);
+
+/*
+ * Make room for up to len bytes and return where they go, or NULL if
+ * they don't fit in the buffer. Unless it returns NULL, the buffer stays
+ * locked until spool_commit () says how many of them were used
+ */
+char *spool_reserve (spool_t *spool,size_t len);
+void spool_commit (spool_t *spool,size_t len);
+
+/*
+ * Write what's left, close the file and free the spool
+ */
+void spool_close (spool_t *spool);
+
+#endif	/* #ifndef SPOOL_H */
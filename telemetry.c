@@ -0,0 +1,104 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Telemetry writer. Games format their records and append them to a
+ * spool, which writes them to the file without making the game wait for
+ * the disk. When the file can't keep up, records are dropped and counted
+ * instead of piling up.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "typedefs.h"
+#include "spool.h"
+#include "telemetry.h"
+
+/*
+ * Macros
+ */
+
+/* Size of each of the two buffers */
+#define BUFSIZE 65536
+
+/* Longest formatted record */
+#define MAXRECORD 512
+
+/*
+ * Global variables
+ */
+
+static const char shapenames[NUMSHAPES] = { 'Z', 'S', 'T', 'O', 'L', 'J', 'I' };
+
+static bool csv;
+static spool_t *spool;
+static unsigned long dropped;
+
+/*
+ * Functions
+ */
+
+/* Start writing records to a file */
+bool telemetry_open (const char *filename)
+{
+   static const char header[] = "game,piece,type,x,y,orientation,moves,rotations,dropcount,efficiency,droppedlines,lines,score,level,think_us\n";
+   size_t len = strlen (filename);
+   if ((spool = spool_open (filename,BUFSIZE)) == NULL) return FALSE;
+   csv = len >= 4 && strcmp (filename + len - 4,".csv") == 0;
+   if (csv) spool_write (spool,header,sizeof (header) - 1);
+   return TRUE;
+}
+
+/* Queue a record */
+void telemetry_record (const record_t *record)
+{
+   char buf[MAXRECORD];
+   int len;
+   if (spool == NULL) return;
+   len = snprintf (buf,sizeof (buf),
+				   csv ?
+				   "%u,%d,%c,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%lld\n" :
+				   "{\"game\":%u,\"piece\":%d,\"type\":\"%c\",\"x\":%d,\"y\":%d,\"orientation\":%d,"
+				   "\"moves\":%d,\"rotations\":%d,\"dropcount\":%d,\"efficiency\":%d,\"droppedlines\":%d,"
+				   "\"lines\":%d,\"score\":%d,\"level\":%d,\"think_us\":%lld}\n",
+				   record->game,record->piece,shapenames[record->type],record->x,record->y,record->orientation,
+				   record->status.moves,record->status.rotations,record->status.dropcount,record->status.efficiency,
+				   record->status.droppedlines,record->status.currentdroppedlines,record->score,record->level,record->think);
+   if (!spool_write (spool,buf,len)) __atomic_add_fetch (&dropped,1,__ATOMIC_RELAXED);
+}
+
+/* Write what's left and close the file */
+void telemetry_close ()
+{
+   if (spool == NULL) return;
+   spool_close (spool);
+   spool = NULL;
+   if (dropped) fprintf (stderr,"telemetry: %lu records dropped\n",dropped);
+}
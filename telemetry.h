@@ -0,0 +1,75 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "typedefs.h"		/* bool */
+#include "engine.h"			/* status_t */
+
+/*
+ * Type definitions
+ */
+
+/* What happened to a single piece */
+typedef struct
+{
+   unsigned int game;		/* game number, 0 if there's only one */
+   int piece;				/* number of the piece in the game, from 1 */
+   int type;				/* shape */
+   int x,y;					/* where it landed */
+   int orientation;			/* clockwise quarter turns from the way it appeared */
+   status_t status;			/* engine status when it landed, efficiency after it */
+   int score;				/* score it earned */
+   int level;				/* level it was played on */
+   long long think;			/* microseconds from appearing to landing */
+} record_t;
+
+/*
+ * Functions
+ */
+
+/*
+ * Start writing records to a file, as CSV if its name ends in .csv
+ * and as JSON Lines otherwise. Returns FALSE if the file can't be
+ * created.
+ */
+bool telemetry_open (const char *filename);
+
+/*
+ * Queue a record. Never waits for the file: records that don't fit
+ * in the buffer are dropped. Does nothing if telemetry is off
+ */
+void telemetry_record (const record_t *record);
+
+/*
+ * Write what's left and close the file
+ */
+void telemetry_close ();
+
+#endif	/* #ifndef TELEMETRY_H */
@@ -30,469 +30,74 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
-#include <pwd.h>
-#include <sys/types.h>
+#include <limits.h>
 #include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
 
 #include "typedefs.h"
 #include "utils.h"
 #include "io.h"
-#include "config.h"
 #include "engine.h"
+#include "game.h"
+#include "scores.h"
+#include "telemetry.h"
+#include "snapshot.h"
+#include "history.h"
+#include "cast.h"
+#include "replay.h"
 
 /*
  * Macros
  */
 
-/* Upper left corner of board */
-#define XTOP ((out_width () - NUMROWS - 3) >> 1)
-#define YTOP ((out_height () - NUMCOLS - 9) >> 1)
+/* Shapes in a benchmark game, since the AI hardly ever loses */
+#define BENCHSHAPES 1000
 
-/* Maximum digits in a number (i.e. number of digits in score, */
-/* number of blocks, etc. should not exceed this value */
-#define MAXDIGITS 5
-
-/* Number of levels in the game */
-#define MINLEVEL	1
-#define MAXLEVEL	9
-
-/* This calculates the time allowed to move a shape, before it is moved a row down */
-#define DELAY (1000000 / (level + 2))
-
-/* The score is multiplied by this to avoid losing precision */
-#define SCOREFACTOR 2
-
-/* This calculates the stored score value */
-#define SCOREVAL(x) (SCOREFACTOR * (x))
-
-/* This calculates the real (displayed) value of the score */
-#define GETSCORE(score) ((score) / SCOREFACTOR)
-
-static bool shownext;
-static bool dottedlines;
-static bool shadow;
-static int level = MINLEVEL - 1,shapecount[NUMSHAPES];
-static char blockchar = ' ';
+/* Most ticks we play in a row to catch up with the clock. Beyond that it is let go */
+#define MAXLAG 25
 
 /*
- * Functions
+ * Global variables
  */
 
-/* This function is responsible for increasing the score appropriately whenever
- * a block collides at the bottom of the screen (or the top of the heap */
-static void score_function (engine_t *engine)
-{
-   int score = SCOREVAL (level * (engine->status.dropcount + 1));
-   score += SCOREVAL ((level + 10) * engine->status.currentdroppedlines * engine->status.currentdroppedlines);
+/* Threads the rollouts are played in */
+static pool_t *pool = NULL;
 
-   if (shownext) score /= 2;
-   if (dottedlines) score /= 2;
+/* Number of benchmark games, and the seed of the first one */
+static int bench = 0,seed = 1;
 
-   engine->score += score;
-}
+/* An output backend was picked, so benchmark games are drawn */
+static bool drawing = FALSE;
 
-/* Draw the board on the screen */
-static void drawboard (board_t board)
-{
-   int x,y;
-   out_setattr (ATTR_OFF);
-   for (y = 1; y < NUMROWS - 1; y++) for (x = 0; x < NUMCOLS - 1; x++)
-	 {
-		out_gotoxy (XTOP + x * 2,YTOP + y);
-		switch (board[x][y])
-		  {
-			 /* Wall */
-		   case WALL:
-			 out_setattr (ATTR_BOLD);
-			 out_setcolor (COLOR_BLUE,COLOR_BLACK);
-			 out_putch ('<');
-			 out_putch ('>');
-			 out_setattr (ATTR_OFF);
-			 break;
-			 /* Background */
-		   case 0:
-			 if (dottedlines)
-			   {
-				  out_setcolor (COLOR_BLUE,COLOR_BLACK);
-				  out_putch ('.');
-				  out_putch (' ');
-			   }
-			 else
-			   {
-				  out_setcolor (COLOR_BLACK,COLOR_BLACK);
-				  out_putch (' ');
-				  out_putch (' ');
-			   }
-			 break;
-			 /* Block */
-		   default:
-			 out_setcolor (COLOR_BLACK,board[x][y]);
-			 out_putch (blockchar);
-			 out_putch (blockchar);
-		  }
-	 }
-   out_setattr (ATTR_OFF);
-}
+/* The session is recorded */
+static bool recording = FALSE;
 
-/* Show the next piece on the screen */
-static void drawnext (int shapenum,int x,int y)
-{
-   int i;
-   block_t ofs[NUMSHAPES] =
-	 { { 1,  0 }, { 1,  0 }, { 1, -1 }, { 2,  0 }, { 1, -1 }, { 1, -1 }, { 0, -1 } };
-   out_setcolor (COLOR_BLACK,COLOR_BLACK);
-   for (i = y - 2; i < y + 2; i++)
-	 {
-		out_gotoxy (x - 2,i);
-		out_printf ("        ");
-	 }
-   out_setcolor (COLOR_BLACK,SHAPES[shapenum].color);
-   for (i = 0; i < NUMBLOCKS; i++)
-	 {
-		out_gotoxy (x + SHAPES[shapenum].block[i].x * 2 + ofs[shapenum].x,
-					y + SHAPES[shapenum].block[i].y + ofs[shapenum].y);
-		out_putch (' ');
-		out_putch (' ');
-	 }
-}
+/* Where the keys of the game are recorded, and where the ones played back come from */
+static const char *journal = NULL,*replayfile = NULL;
 
-/* Draw the background */
-static void drawbackground ()
-{
-   out_setattr (ATTR_OFF);
-   out_setcolor (COLOR_WHITE,COLOR_BLACK);
-   out_gotoxy (4,YTOP + 7);   out_printf ("H E L P");
-   out_gotoxy (1,YTOP + 9);   out_printf ("p: Pause");
-   out_gotoxy (1,YTOP + 10);  out_printf ("j: Left");
-   out_gotoxy (1,YTOP + 11);  out_printf ("l: Right");
-   out_gotoxy (1,YTOP + 12);  out_printf ("K: Rotate (clockwise)");
-   out_gotoxy (1,YTOP + 13);  out_printf ("k: Rotate (counterclockwise)");
-   out_gotoxy (1,YTOP + 14);  out_printf ("s: Draw next");
-   out_gotoxy (1,YTOP + 15);  out_printf ("d: Toggle lines");
-   out_gotoxy (1,YTOP + 16);  out_printf ("a: Speed up");
-   out_gotoxy (1,YTOP + 17);  out_printf ("q: Quit");
-   out_gotoxy (2,YTOP + 18);  out_printf ("SPACE: Drop");
-   out_gotoxy (3,YTOP + 20);  out_printf ("Next:");
-}
+/* Ticks go this many times as fast as the clock, 0 for as fast as they can */
+static int speed = 1;
 
-static int getsum ()
-{
-   int i,sum = 0;
-   for (i = 0; i < NUMSHAPES; i++) sum += shapecount[i];
-   return (sum);
-}
-
-/* This show the current status of the game */
-static void showstatus (engine_t *engine)
-{
-   static const int shapenum[NUMSHAPES] = { 4, 6, 5, 1, 0, 3, 2 };
-   char tmp[MAXDIGITS + 1];
-   int i,sum = getsum ();
-   out_setattr (ATTR_OFF);
-   out_setcolor (COLOR_WHITE,COLOR_BLACK);
-   out_gotoxy (1,YTOP + 1);   out_printf ("Your level: %d",level);
-   out_gotoxy (1,YTOP + 2);   out_printf ("Full lines: %d",engine->status.droppedlines);
-   out_gotoxy (2,YTOP + 4);   out_printf ("Score");
-   out_setattr (ATTR_BOLD);
-   out_setcolor (COLOR_YELLOW,COLOR_BLACK);
-   out_printf ("  %d",GETSCORE (engine->score));
-   if (shownext) drawnext (engine->nextshape,3,YTOP + 22);
-   out_setattr (ATTR_OFF);
-   out_setcolor (COLOR_WHITE,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 12,YTOP + 1);
-   out_printf ("STATISTICS");
-   out_setcolor (COLOR_BLACK,COLOR_MAGENTA);
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 3);
-   out_printf ("      ");
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 4);
-   out_printf ("  ");
-   out_setcolor (COLOR_MAGENTA,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 3);
-   out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[0]]);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 3);
-   out_printf ("%s",tmp);
-   out_setcolor (COLOR_BLACK,COLOR_RED);
-   out_gotoxy (out_width () - MAXDIGITS - 13,YTOP + 5);
-   out_printf ("        ");
-   out_setcolor (COLOR_RED,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 5);
-   out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[1]]);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 5);
-   out_printf ("%s",tmp);
-   out_setcolor (COLOR_BLACK,COLOR_WHITE);
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 7);
-   out_printf ("      ");
-   out_gotoxy (out_width () - MAXDIGITS - 13,YTOP + 8);
-   out_printf ("  ");
-   out_setcolor (COLOR_WHITE,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 7);
-   out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[2]]);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 7);
-   out_printf ("%s",tmp);
-   out_setcolor (COLOR_BLACK,COLOR_GREEN);
-   out_gotoxy (out_width () - MAXDIGITS - 9,YTOP + 9);
-   out_printf ("    ");
-   out_gotoxy (out_width () - MAXDIGITS - 11,YTOP + 10);
-   out_printf ("    ");
-   out_setcolor (COLOR_GREEN,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 9);
-   out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[3]]);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 9);
-   out_printf ("%s",tmp);
-   out_setcolor (COLOR_BLACK,COLOR_CYAN);
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 11);
-   out_printf ("    ");
-   out_gotoxy (out_width () - MAXDIGITS - 15,YTOP + 12);
-   out_printf ("    ");
-   out_setcolor (COLOR_CYAN,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 11);
-   out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[4]]);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 11);
-   out_printf ("%s",tmp);
-   out_setcolor (COLOR_BLACK,COLOR_BLUE);
-   out_gotoxy (out_width () - MAXDIGITS - 9,YTOP + 13);
-   out_printf ("    ");
-   out_gotoxy (out_width () - MAXDIGITS - 9,YTOP + 14);
-   out_printf ("    ");
-   out_setcolor (COLOR_BLUE,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 13);
-   out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[5]]);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 13);
-   out_printf ("%s",tmp);
-   out_setattr (ATTR_OFF);
-   out_setcolor (COLOR_BLACK,COLOR_YELLOW);
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 15);
-   out_printf ("      ");
-   out_gotoxy (out_width () - MAXDIGITS - 15,YTOP + 16);
-   out_printf ("  ");
-   out_setcolor (COLOR_YELLOW,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 3,YTOP + 15);
-   out_putch ('-');
-   snprintf (tmp,MAXDIGITS + 1,"%d",shapecount[shapenum[6]]);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 15);
-   out_printf ("%s",tmp);
-   out_setcolor (COLOR_WHITE,COLOR_BLACK);
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 17);
-   for (i = 0; i < MAXDIGITS + 16; i++) out_putch ('-');
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 18);
-   out_printf ("Sum          :");
-   snprintf (tmp,MAXDIGITS + 1,"%d",sum);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 18);
-   out_printf ("%s",tmp);
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 20);
-   for (i = 0; i < MAXDIGITS + 16; i++) out_putch (' ');
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 20);
-   out_printf ("Score ratio  :");
-   snprintf (tmp,MAXDIGITS + 1,"%d",GETSCORE (engine->score) / sum);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 20);
-   out_printf ("%s",tmp);
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 21);
-   for (i = 0; i < MAXDIGITS + 16; i++) out_putch (' ');
-   out_gotoxy (out_width () - MAXDIGITS - 17,YTOP + 21);
-   out_printf ("Efficiency   :");
-   snprintf (tmp,MAXDIGITS + 1,"%d",engine->status.efficiency);
-   out_gotoxy (out_width () - strlen (tmp) - 1,YTOP + 21);
-   out_printf ("%s",tmp);
-}
-
-          /***************************************************************************/
-          /***************************************************************************/
-          /***************************************************************************/
-
-/* Header for scorefile */
-#define SCORE_HEADER	"Tint 0.02b (c) Abraham vd Merwe - Scores"
-
-/* Header for score title */
-static const char scoretitle[] = "\n\t   TINT HIGH SCORES\n\n\tRank   Score        Name\n\n";
-
-/* Length of a player's name */
-#define NAMELEN 20
-
-/* Number of scores allowed in highscore list */
-#define NUMSCORES 10
-
-typedef struct
-{
-   char name[NAMELEN];
-   int score;
-   time_t timestamp;
-} score_t;
+/* Carry on with the saved game */
+static bool resume = FALSE;
 
-static void getname (char *name)
-{
-   struct passwd *pw = getpwuid (geteuid ());
-
-   fprintf (stderr,"Congratulations! You have a new high score.\n");
-   fprintf (stderr,"Enter your name [%s]: ",pw != NULL ? pw->pw_name : "");
-
-   fgets (name,NAMELEN - 1,stdin);
-   name[strlen (name) - 1] = '\0';
-
-   if (!strlen (name) && pw != NULL)
-	 {
-		strncpy (name,pw->pw_name,NAMELEN);
-		name[NAMELEN - 1] = '\0';
-	 }
-}
+/* Signal that told us to save the game and go */
+static volatile sig_atomic_t hangup = 0;
 
-static void err1 ()
-{
-   fprintf (stderr,"Error creating %s\n",scorefile);
-   exit (EXIT_FAILURE);
-}
-
-static void err2 ()
-{
-   fprintf (stderr,"Error writing to %s\n",scorefile);
-   exit (EXIT_FAILURE);
-}
+/*
+ * Functions
+ */
 
-void showplayerstats (engine_t *engine)
+void showplayerstats (const game_t *game)
 {
+   const engine_t *engine = &game->engine;
    fprintf (stderr,
 			"\n\t   PLAYER STATISTICS\n\n\t"
 			"Score       %11d\n\t"
 			"Efficiency  %11d\n\t"
 			"Score ratio %11d\n",
-			GETSCORE (engine->score),engine->status.efficiency,GETSCORE (engine->score) / getsum ());
-}
-
-static void createscores (int score)
-{
-   FILE *handle;
-   int i,j;
-   score_t scores[NUMSCORES];
-   char header[strlen (SCORE_HEADER)+1];
-   if (score == 0) return;	/* No need saving this */
-   for (i = 1; i < NUMSCORES; i++)
-	 {
-		strcpy (scores[i].name,"None");
-		scores[i].score = -1;
-		scores[i].timestamp = 0;
-	 }
-   getname (scores[0].name);
-   scores[0].score = score;
-   scores[0].timestamp = time (NULL);
-   if ((handle = fopen (scorefile,"w")) == NULL) err1 ();
-   strcpy (header,SCORE_HEADER);
-   i = fwrite (header,strlen (SCORE_HEADER),1,handle);
-   if (i != 1) err2 ();
-   for (i = 0; i < NUMSCORES; i++)
-	 {
-		j = fwrite (scores[i].name,strlen (scores[i].name) + 1,1,handle);
-		if (j != 1) err2 ();
-		j = fwrite (&(scores[i].score),sizeof (int),1,handle);
-		if (j != 1) err2 ();
-		j = fwrite (&(scores[i].timestamp),sizeof (time_t),1,handle);
-		if (j != 1) err2 ();
-	 }
-   fclose (handle);
-
-   fprintf (stderr,"%s",scoretitle);
-   fprintf (stderr,"\t  1* %7d        %s\n\n",score,scores[0].name);
-}
-
-static int cmpscores (const void *a,const void *b)
-{
-   int result;
-   result = (int) ((score_t *) a)->score - (int) ((score_t *) b)->score;
-   /* a < b */
-   if (result < 0) return 1;
-   /* a > b */
-   if (result > 0) return -1;
-   /* a = b */
-   result = (time_t) ((score_t *) a)->timestamp - (time_t) ((score_t *) b)->timestamp;
-   /* a is older */
-   if (result < 0) return -1;
-   /* b is older */
-   if (result > 0) return 1;
-   /* timestamps is equal */
-   return 0;
-}
-
-static void savescores (int score)
-{
-   FILE *handle;
-   int i,j,ch;
-   score_t scores[NUMSCORES];
-   char header[strlen (SCORE_HEADER)+1];
-   time_t tmp = 0;
-   if ((handle = fopen (scorefile,"r")) == NULL)
-	 {
-		createscores (score);
-		return;
-	 }
-   i = fread (header,strlen (SCORE_HEADER),1,handle);
-   if ((i != 1) || (strncmp (SCORE_HEADER,header,strlen (SCORE_HEADER)) != 0))
-	 {
-		createscores (score);
-		return;
-	 }
-   for (i = 0; i < NUMSCORES; i++)
-	 {
-		j = 0;
-		while ((ch = fgetc (handle)) != '\0')
-		  {
-			 if ((ch == EOF) || (j >= NAMELEN - 2))
-			   {
-				  createscores (score);
-				  return;
-			   }
-			 scores[i].name[j++] = (char) ch;
-		  }
-		scores[i].name[j] = '\0';
-		j = fread (&(scores[i].score),sizeof (int),1,handle);
-		if (j != 1)
-		  {
-			 createscores (score);
-			 return;
-		  }
-		j = fread (&(scores[i].timestamp),sizeof (time_t),1,handle);
-		if (j != 1)
-		  {
-			 createscores (score);
-			 return;
-		  }
-	 }
-   fclose (handle);
-   if (score > scores[NUMSCORES - 1].score)
-	 {
-		getname (scores[NUMSCORES - 1].name);
-		scores[NUMSCORES - 1].score = score;
-		scores[NUMSCORES - 1].timestamp = tmp = time (NULL);
-	 }
-   qsort (scores,NUMSCORES,sizeof (score_t),cmpscores);
-   if ((handle = fopen (scorefile,"w")) == NULL) err2 ();
-   strcpy (header,SCORE_HEADER);
-   i = fwrite (header,strlen (SCORE_HEADER),1,handle);
-   if (i != 1) err2 ();
-   for (i = 0; i < NUMSCORES; i++)
-	 {
-		j = fwrite (scores[i].name,strlen (scores[i].name) + 1,1,handle);
-		if (j != 1) err2 ();
-		j = fwrite (&(scores[i].score),sizeof (int),1,handle);
-		if (j != 1) err2 ();
-		j = fwrite (&(scores[i].timestamp),sizeof (time_t),1,handle);
-		if (j != 1) err2 ();
-	 }
-   fclose (handle);
-
-   fprintf (stderr,"%s",scoretitle);
-   i = 0;
-   while ((i < NUMSCORES) && (scores[i].score != -1))
-	 {
-		j = scores[i].timestamp == tmp ? '*' : ' ';
-		fprintf (stderr,"\t %2d%c %7d        %s\n",i + 1,j,scores[i].score,scores[i].name);
-		i++;
-	 }
-   fprintf (stderr,"\n");
+			GETSCORE (engine->score),engine->status.efficiency,GETSCORE (engine->score) / game_shapes (game));
 }
 
           /***************************************************************************/
@@ -501,17 +106,30 @@ static void savescores (int score)
 
 static void showhelp ()
 {
-   fprintf (stderr,"USAGE: tint [-h] [-l level] [-n] [-d] [-b char]\n");
+   fprintf (stderr,"USAGE: tint [-h] [-l level] [-n] [-d] [-b char] [-s] [-o output] [-T file] [-A] [-R] [-H] [-P] [--bench games] [--seed seed] [--resume] [--record file] [--journal file] [--replay file] [--speed n]\n");
    fprintf (stderr,"  -h           Show this help message\n");
    fprintf (stderr,"  -l <level>   Specify the starting level (%d-%d)\n",MINLEVEL,MAXLEVEL);
    fprintf (stderr,"  -n           Draw next shape\n");
    fprintf (stderr,"  -d           Draw vertical dotted lines\n");
    fprintf (stderr,"  -b <char>    Use this character to draw blocks instead of spaces\n");
    fprintf (stderr,"  -s           Draw shadow of shape\n");
+   fprintf (stderr,"  -o <output>  Output backend: ncurses, ansi, slow or null (default %s)\n",io_name ());
+   fprintf (stderr,"  -T <file>    Write a record of every piece played to file (CSV if it ends in .csv)\n");
+   fprintf (stderr,"  -A           Let the computer play\n");
+   fprintf (stderr,"  -R           Let the computer play, trying out every move on all CPUs\n");
+   fprintf (stderr,"  -H           Show where the computer would put each shape\n");
+   fprintf (stderr,"  -P           Practice: u takes back the last shape, and the score isn't kept\n");
+   fprintf (stderr,"  --bench <n>  Let the computer play n games of up to %d shapes (drawn only with -o), and show how fast that went\n",BENCHSHAPES);
+   fprintf (stderr,"  --seed <s>   Seed of the first benchmark game (default %d)\n",seed);
+   fprintf (stderr,"  --resume     Carry on with the game saved by pressing S, or when the terminal went away\n");
+   fprintf (stderr,"  --record <f> Record the session for asciinema (with the ansi or slow output)\n");
+   fprintf (stderr,"  --journal <f> Record the keys of the game, to play it back with --replay\n");
+   fprintf (stderr,"  --replay <f> Play back a game recorded with --journal\n");
+   fprintf (stderr,"  --speed <n>  Play it back n times as fast, 0 for as fast as it goes (default 1)\n");
    exit (EXIT_FAILURE);
 }
 
-static void parse_options (int argc,char *argv[])
+static void parse_options (game_t *game,int argc,char *argv[])
 {
    int i = 1;
    while (i < argc)
@@ -523,8 +141,8 @@ static void parse_options (int argc,char *argv[])
 		else if (strcmp (argv[i],"-l") == 0)
 		  {
 			 i++;
-			 if (i >= argc || !str2int (&level,argv[i])) showhelp ();
-			 if ((level < MINLEVEL) || (level > MAXLEVEL))
+			 if (i >= argc || !str2int (&game->level,argv[i])) showhelp ();
+			 if ((game->level < MINLEVEL) || (game->level > MAXLEVEL))
 			   {
 				  fprintf (stderr,"You must specify a level between %d and %d\n",MINLEVEL,MAXLEVEL);
 				  exit (EXIT_FAILURE);
@@ -532,17 +150,109 @@ static void parse_options (int argc,char *argv[])
 		  }
 		/* Show next? */
 		else if (strcmp (argv[i],"-n") == 0)
-		  shownext = TRUE;
+		  game->shownext = TRUE;
 		else if(strcmp(argv[i],"-d")==0)
-		  dottedlines = TRUE;
+		  game->dottedlines = TRUE;
 		else if(strcmp(argv[i], "-b")==0)
 		  {
 		    i++;
 		    if (i >= argc || strlen(argv[i]) < 1) showhelp();
-		    blockchar = argv[i][0];
+		    game->blockchar = argv[i][0];
 		  }
 		else if (strcmp (argv[i],"-s") == 0)
-            shadow = TRUE;
+			game->shadow = TRUE;
+		else if (strcmp (argv[i],"-o") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 if (!io_select (argv[i]))
+			   {
+				  fprintf (stderr,"Unknown output backend -- %s\n",argv[i]);
+				  exit (EXIT_FAILURE);
+			   }
+			 drawing = TRUE;
+		  }
+		else if (strcmp (argv[i],"-A") == 0 || strcmp (argv[i],"-R") == 0)
+		  {
+			 if (game->ai == NULL && (game->ai = ai_new (&AI_WEIGHTS)) == NULL)
+			   {
+				  perror ("ai_new");
+				  exit (EXIT_FAILURE);
+			   }
+			 if (argv[i][1] == 'R' && game->rollout == NULL &&
+				 ((pool = pool_new (sysconf (_SC_NPROCESSORS_ONLN))) == NULL ||
+				  (game->rollout = rollout_new (pool,ROLLOUTS,HORIZON,TRUE)) == NULL))
+			   {
+				  perror ("rollout_new");
+				  exit (EXIT_FAILURE);
+			   }
+		  }
+		else if (strcmp (argv[i],"-H") == 0)
+		  {
+			 if (game->hint == NULL && (game->hint = hint_new ()) == NULL)
+			   {
+				  perror ("hint_new");
+				  exit (EXIT_FAILURE);
+			   }
+		  }
+		else if (strcmp (argv[i],"-P") == 0)
+		  {
+			 if (game->history == NULL && (game->history = history_new ()) == NULL)
+			   {
+				  perror ("history_new");
+				  exit (EXIT_FAILURE);
+			   }
+		  }
+		else if (strcmp (argv[i],"--bench") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&bench,argv[i]) || bench < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--seed") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&seed,argv[i])) showhelp ();
+		  }
+		else if (strcmp (argv[i],"--resume") == 0)
+		  resume = TRUE;
+		else if (strcmp (argv[i],"--record") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 if (!cast_open (argv[i]))
+			   {
+				  perror (argv[i]);
+				  exit (EXIT_FAILURE);
+			   }
+			 recording = TRUE;
+		  }
+		else if (strcmp (argv[i],"--journal") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 journal = argv[i];
+		  }
+		else if (strcmp (argv[i],"--replay") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 replayfile = argv[i];
+		  }
+		else if (strcmp (argv[i],"--speed") == 0)
+		  {
+			 i++;
+			 if (i >= argc || !str2int (&speed,argv[i]) || speed < 0) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-T") == 0)
+		  {
+			 i++;
+			 if (i >= argc) showhelp ();
+			 if (!telemetry_open (argv[i]))
+			   {
+				  perror (argv[i]);
+				  exit (EXIT_FAILURE);
+			   }
+		  }
 		else
 		  {
 			 fprintf (stderr,"Invalid option -- %s\n",argv[i]);
@@ -552,7 +262,7 @@ static void parse_options (int argc,char *argv[])
 	 }
 }
 
-static void choose_level ()
+static void choose_level (game_t *game)
 {
    char buf[NAMELEN];
 
@@ -562,33 +272,182 @@ static void choose_level ()
 		fgets (buf,NAMELEN - 1,stdin);
 		buf[strlen (buf) - 1] = '\0';
 	 }
-   while (!str2int (&level,buf) || level < MINLEVEL || level > MAXLEVEL);
+   while (!str2int (&game->level,buf) || game->level < MINLEVEL || game->level > MAXLEVEL);
+}
+
+/* Where an unfinished game is kept: in the home directory, or the current one if there's no home */
+static const char *savefile ()
+{
+   static char filename[PATH_MAX];
+   const char *home = getenv ("HOME");
+   if (!*filename) snprintf (filename,sizeof (filename),"%s%s.tint.save",home != NULL ? home : "",home != NULL ? "/" : "");
+   return (filename);
+}
+
+/* Only games a person plays on their own, where they can see them, are saved to carry on with later */
+static bool resumable (const game_t *game)
+{
+   return (game->ai == NULL && game->history == NULL && game->hint == NULL && strcmp (io_name (),"null") != 0);
+}
+
+/* Pick up the saved game, or make sure there isn't one we'd overwrite */
+static void restore (game_t *game)
+{
+   char buf[NAMELEN];
+   if (!resumable (game))
+	 {
+		if (!resume) return;
+		fprintf (stderr,"Only games a person plays on their own can be carried on with\n");
+		exit (EXIT_FAILURE);
+	 }
+   /* It may have been left behind by a crash, so don't just refuse to play */
+   while (!resume && access (savefile (),F_OK) == 0)
+	 {
+		fprintf (stderr,"There's a saved game in %s. Carry on with it [c] or throw it away [t]? ",savefile ());
+		if (fgets (buf,sizeof (buf),stdin) == NULL) exit (EXIT_FAILURE);
+		if (*buf == 'c') resume = TRUE;
+		else if (*buf == 't') unlink (savefile ());
+	 }
+   if (resume && !snapshot_load (game,savefile ()))
+	 {
+		fprintf (stderr,"Can't carry on with the game saved in %s\n",savefile ());
+		exit (EXIT_FAILURE);
+	 }
+}
+
+static void sighandler (int sig)
+{
+   hangup = sig;
 }
 
-static bool evaluate (engine_t *engine)
+/*
+ * Microseconds until the next tick of the game is due, counting from
+ * epoch. If we fell far behind (suspended, or the AI took its time), the
+ * clock is let go rather than playing all the missed ticks at once
+ */
+static int nexttick (const game_t *game,long long *epoch)
 {
-    bool finished = FALSE;
-    switch (engine_evaluate (engine))
-    {
-        /* game over (board full) */
-        case -1:
-            if ((level < MAXLEVEL) && ((engine->status.droppedlines / 10) > level)) level++;
-            finished = TRUE;
-            break;
-            /* shape at bottom, next one released */
-        case 0:
-            if ((level < MAXLEVEL) && ((engine->status.droppedlines / 10) > level))
-            {
-                level++;
-                in_timeout (DELAY);
-            }
-            shapecount[engine->curshape]++;
-            break;
-            /* shape moved down one line */
-        case 1:
-            break;
-    }
-    return finished;
+   long long now,due;
+   if (!speed) return (0);
+   now = microseconds ();
+   due = *epoch + (long long) (game->tick + 1) * TICK / speed;
+   if (now - due > MAXLAG * TICK)
+	 {
+		*epoch += now - due - MAXLAG * TICK;
+		due = now - MAXLAG * TICK;
+	 }
+   return (due > now ? due - now : 0);
+}
+
+/* Play the game. Keys are handled in the tick they come in, and ticks are played when they're due */
+static void play (game_t *game)
+{
+   long long epoch = microseconds ();
+   bool dirty = TRUE;
+   int ch,saved = 0;
+   while (!game->finished && !hangup)
+	 {
+		if (game_think (game)) dirty = TRUE;
+		if (dirty) game_draw (game);
+		dirty = FALSE;
+		in_timeout (nexttick (game,&epoch));
+		/* Check if user pressed a key */
+		if ((ch = in_getch ()) != ERR)
+		  {
+			 replay_key (game->tick,ch);
+			 game_key (game,ch);
+			 dirty = TRUE;
+		  }
+		else if (!nexttick (game,&epoch))
+		  dirty = game_step (game);
+		/* Save the game every time a shape lands, in case we crash */
+		if (!game->finished && saved != game_shapes (game) && resumable (game))
+		  {
+			 saved = game_shapes (game);
+			 snapshot_save (game,savefile ());
+		  }
+	 }
+}
+
+/* Play back a recorded game, until a key is pressed. Returns TRUE if it got to the end */
+static bool playback (game_t *game)
+{
+   long long epoch = microseconds ();
+   unsigned long tick = 0;
+   bool more,dirty = TRUE;
+   int key;
+   more = replay_next (&tick,&key);
+   while (!game->finished && !hangup && (more || game->tick < tick))
+	 {
+		if (dirty) game_draw (game);
+		dirty = FALSE;
+		/* The keys of a tick go before it is played, like they did */
+		if (more && tick <= game->tick)
+		  {
+			 game_key (game,key);
+			 more = replay_next (&tick,&key);
+			 dirty = TRUE;
+			 continue;
+		  }
+		in_timeout (nexttick (game,&epoch));
+		if (in_getch () != ERR) return (FALSE);
+		if (!nexttick (game,&epoch)) dirty = game_step (game);
+	 }
+   return (!more);
+}
+
+/* Play games with the AI as fast as it goes, drawing them only if asked to */
+static void benchmark (const game_t *options)
+{
+   game_t game;
+   ai_t *ai;
+   struct rusage usage;
+   long long started,elapsed;
+   double shapes = 0,score = 0;
+   int i;
+   if ((ai = ai_new (&AI_WEIGHTS)) == NULL)
+	 {
+		perror ("ai_new");
+		exit (EXIT_FAILURE);
+	 }
+   if (drawing)
+	 {
+		io_init ();
+		cast_start ();
+	 }
+   else io_select ("null");
+   started = microseconds ();
+   for (i = 0; i < bench; i++)
+	 {
+		game_init (&game,seed + i);
+		game.level = options->level < MINLEVEL ? MINLEVEL : options->level;
+		game.shownext = options->shownext;
+		game.dottedlines = options->dottedlines;
+		game.shadow = options->shadow;
+		game.blockchar = options->blockchar;
+		game.ai = ai;
+		game.lookahead = 1;
+		if (drawing) game_start (&game);
+		while (!game.finished && game_shapes (&game) <= BENCHSHAPES)
+		  {
+			 game_think (&game);
+			 if (drawing) game_draw (&game);
+			 game_tick (&game);
+		  }
+		shapes += game_shapes (&game) - 1;		/* the last one never landed */
+		score += GETSCORE (game.engine.score);
+	 }
+   elapsed = microseconds () - started;
+   if (drawing) io_close ();
+   cast_close ();
+   getrusage (RUSAGE_SELF,&usage);
+   printf ("%d games in %.2f s\n",bench,elapsed / 1e6);
+   printf ("  games/s    %12.1f\n",bench * 1e6 / elapsed);
+   printf ("  shapes/s   %12.0f\n",shapes * 1e6 / elapsed);
+   printf ("  mean score %12.1f\n",score / bench);
+   printf ("  peak RSS   %9ld kB\n",usage.ru_maxrss);
+   ai_free (ai);
+   exit (EXIT_SUCCESS);
 }
 
           /***************************************************************************/
@@ -597,104 +456,95 @@ static bool evaluate (engine_t *engine)
 
 int main (int argc,char *argv[])
 {
-   bool finished;
-   int ch;
-   engine_t engine;
+   bool ended = FALSE;
+   game_t game;
    /* Initialize */
-   rand_init ();							/* must be called before engine_init () */
-   engine_init (&engine,score_function);	/* must be called before using engine.curshape */
-   finished = shownext = shadow = FALSE;
-   memset (shapecount,0,NUMSHAPES * sizeof (int));
-   shapecount[engine.curshape]++;
-   parse_options (argc,argv);				/* must be called after initializing variables */
-   engine.shadow = shadow;
-   if (level < MINLEVEL) choose_level ();
-   io_init ();
-   drawbackground ();
-   in_timeout (DELAY);
-   /* Main loop */
-   do
+   rand_init ();
+   game_init (&game,rand_value (INT_MAX));
+   parse_options (&game,argc,argv);		/* must be called after initializing variables */
+   /* Only the ansi backends have frames to record */
+   if (recording && strcmp (io_name (),"ansi") != 0 && strcmp (io_name (),"slow") != 0)
 	 {
-		/* draw shape */
-		showstatus (&engine);
-		drawboard (engine.board);
-		out_refresh ();
-		/* Check if user pressed a key */
-		if ((ch = in_getch ()) != ERR)
+		if (drawing)
 		  {
-			 switch (ch)
-			   {
-				case 'j':
-				case KEY_LEFT:
-				  engine_move (&engine,ACTION_LEFT);
-				  break;
-				case 'k':
-				case KEY_UP:
-				case '\n':
-				  engine_move (&engine,ACTION_ROTATE_COUNTERCLOCKWISE);
-				  break;
-				case 'K':
-				  engine_move (&engine,ACTION_ROTATE_CLOCKWISE);
-				  break;
-				case 'l':
-				case KEY_RIGHT:
-				  engine_move (&engine,ACTION_RIGHT);
-				  break;
-				case KEY_DOWN:
-				  engine_move (&engine,ACTION_DOWN);
-				  break;
-				case ' ':
-				  engine_move (&engine,ACTION_DROP);
-				  finished = evaluate(&engine);          /* prevent key press after drop */
-				  break;
-				  /* show next piece */
-				case 's':
-				  shownext = TRUE;
-				  break;
-				  /* toggle dotted lines */
-				case 'd':
-				  dottedlines = !dottedlines;
-				  break;
-				  /* next level */
-				case 'a':
-				  if (level < MAXLEVEL)
-					{
-					   level++;
-					   in_timeout (DELAY);
-					}
-				  else out_beep ();
-				  break;
-				  /* quit */
-				case 'q':
-				  finished = TRUE;
-				  break;
-				  /* pause */
-				case 'p':
-				  out_setcolor (COLOR_WHITE,COLOR_BLACK);
-				  out_gotoxy ((out_width () - 34) / 2,out_height () - 2);
-				  out_printf ("Paused - Press any key to continue");
-				  while ((ch = in_getch ()) == ERR) ;	/* Wait for a key to be pressed */
-				  in_flush ();							/* Clear keyboard buffer */
-				  out_gotoxy ((out_width () - 34) / 2,out_height () - 2);
-				  out_printf ("                                  ");
-				  break;
-				  /* unknown keypress */
-				default:
-				  out_beep ();
-			   }
-			 in_flush ();
+			 fprintf (stderr,"Only the ansi and slow output backends can be recorded\n");
+			 exit (EXIT_FAILURE);
 		  }
-		else
-		  finished = evaluate(&engine);
+		io_select ("ansi");
+	 }
+   if (bench) benchmark (&game);
+   if (replayfile != NULL)
+	 {
+		if (!replay_load (replayfile,&game))
+		  {
+			 fprintf (stderr,"Can't play back the game in %s\n",replayfile);
+			 exit (EXIT_FAILURE);
+		  }
+	 }
+   else
+	 {
+		restore (&game);
+		if (game.level < MINLEVEL) choose_level (&game);
+	 }
+   /* Keys only play the same game again from the start (so not one carried on with in restore ()), and the AI doesn't press any */
+   if ((journal != NULL || replayfile != NULL) && (game.ai != NULL || resume || (journal != NULL && replayfile != NULL)))
+	 {
+		fprintf (stderr,"Only new games played by a person can be recorded or played back, and not both at once\n");
+		exit (EXIT_FAILURE);
 	 }
-   while (!finished);
+   if (journal != NULL && !replay_record (journal,&game))
+	 {
+		perror (journal);
+		exit (EXIT_FAILURE);
+	 }
+   /* Nobody is watching, so there's no reason to wait for the clock */
+   if (strcmp (io_name (),"null") == 0) speed = 0;
+   else if (replayfile == NULL) speed = 1;
+   io_init ();
+   cast_start ();
+   game_start (&game);
+   /* After io_init (), which may want these signals for itself */
+   signal (SIGHUP,sighandler);
+   signal (SIGTERM,sighandler);
+   signal (SIGINT,sighandler);
+   if (replayfile != NULL) ended = playback (&game);
+   else play (&game);
    /* Restore console settings and exit */
    io_close ();
-   /* Don't bother the player if he want's to quit */
-   if (ch != 'q')
+   telemetry_close ();
+   cast_close ();
+   if (journal != NULL) replay_stop (&game);
+   if (replayfile != NULL)
+	 {
+		if (ended)
+		  printf ("Played back %lu ticks, score %d: %s\n",game.tick,GETSCORE (game.engine.score),
+				  replay_matches (&game) ? "the same game as the one recorded" : "NOT the game that was recorded");
+	 }
+   else if (!resumable (&game))
+	 {
+		if (game.suspended) fprintf (stderr,"Only games a person plays on their own can be saved\n");
+	 }
+   else if (game.suspended || hangup)
+	 {
+		if (!snapshot_save (&game,savefile ()))
+		  perror (savefile ());
+		else if (game.suspended)
+		  fprintf (stderr,"Game saved. Carry on with it with tint --resume\n");
+	 }
+   else unlink (savefile ());
+   if (game.rollout != NULL)
+	 {
+		rollout_free (game.rollout);
+		pool_free (pool);
+	 }
+   if (game.ai != NULL) ai_free (game.ai);
+   if (game.hint != NULL) hint_free (game.hint);
+   if (game.history != NULL) history_free (game.history);
+   /* Don't bother the player if he want's to quit, if nobody was watching, if the computer played or if it was practice */
+   if (!game.quit && strcmp (io_name (),"null") != 0 && game.ai == NULL && game.history == NULL && replayfile == NULL)
 	 {
-		showplayerstats (&engine);
-		savescores (GETSCORE (engine.score));
+		showplayerstats (&game);
+		savescores (GETSCORE (game.engine.score));
 	 }
    exit (EXIT_SUCCESS);
 }
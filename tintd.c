@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Score daemon. Keeps the score table in memory and answers requests from
+ * tint over a Unix domain socket (see scores.h for the protocol). Scores
+ * are appended to a write-ahead log before they are acknowledged and merged
+ * into the score file every few seconds, using the same locking as tint
+ * itself, so tint can safely fall back to the score file when the daemon
+ * isn't running.
+ */
+
+#define _GNU_SOURCE		/* struct ucred */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "typedefs.h"
+#include "scores.h"
+
+/*
+ * Macros
+ */
+
+/* Most clients connected at the same time */
+#define MAXCLIENTS 512
+
+/* Size of the request and reply buffers of a client */
+#define INSIZE 4096
+#define OUTSIZE 16384
+
+/* Seconds between merging the log into the score file */
+#define CHECKPOINT 10
+
+/* Size of the buffer for log entries of a single round */
+#define LOGSIZE 65536
+
+/*
+ * Type definitions
+ */
+
+typedef struct
+{
+   int fd;
+   bool closed;
+   bool trusted;			/* may add scores */
+   char in[INSIZE];
+   size_t inlen;
+   char out[OUTSIZE];
+   size_t outlen;
+} client_t;
+
+/*
+ * Global variables
+ */
+
+static const char *dbfile = SCOREFILE;
+static const char *socketpath = SCORESOCKET;
+static char logfile[256];
+
+/* Scores in memory, including those not merged into the score file yet */
+static scoredb_t db;
+
+/* Scores that are in the log, but not in the score file yet */
+static score_t *pending;
+static int numpending,maxpending;
+
+/* Log entries written during this round */
+static char logbuf[LOGSIZE];
+static size_t loglen;
+static int logfd;
+
+/* Group of the score file. Only tint, which is setgid to it, may connect and add scores */
+static gid_t scoregroup;
+
+static client_t *clients[MAXCLIENTS];
+static int numclients;
+
+static volatile sig_atomic_t finished;
+
+/*
+ * Functions
+ */
+
+static void die (const char *msg)
+{
+   fprintf (stderr,"tintd: %s: %s\n",msg,strerror (errno));
+   exit (EXIT_FAILURE);
+}
+
+static void sighandler (int sig)
+{
+   finished = TRUE;
+}
+
+static void addpending (const score_t *score)
+{
+   if (numpending == maxpending)
+	 {
+		maxpending = maxpending ? maxpending * 2 : 64;
+		if ((pending = realloc (pending,maxpending * sizeof (score_t))) == NULL) die ("realloc");
+	 }
+   pending[numpending++] = *score;
+}
+
+/* Merge the pending scores into the score file. Anything other processes */
+/* wrote to the file in the meantime is kept */
+static bool checkpoint ()
+{
+   scoredb_t file;
+   int fd,i;
+   if (!numpending) return TRUE;
+   if ((fd = scoredb_lock (dbfile,LOCK_EX)) < 0) return FALSE;
+   if (!scoredb_load (&file,fd))
+	 {
+		close (fd);
+		return FALSE;
+	 }
+   /* After a crash, some of these may have made it into the file already */
+   for (i = 0; i < numpending; i++)
+	 if (scoredb_find (&file,&pending[i]) < 0) scoredb_add (&file,&pending[i]);
+   if (!scoredb_write (&file,fd,dbfile))
+	 {
+		scoredb_free (&file);
+		close (fd);
+		return FALSE;
+	 }
+   close (fd);
+   if (ftruncate (logfd,0) < 0 || fsync (logfd) < 0) die (logfile);
+   numpending = 0;
+   scoredb_free (&db);
+   db = file;
+   return TRUE;
+}
+
+/* Parse a log entry or ADD request: <score> <timestamp> <name> */
+static bool parsescore (const char *str,score_t *score)
+{
+   long long timestamp;
+   int n;
+   if (sscanf (str,"%d %lld %n",&score->score,&timestamp,&n) != 2 || !str[n] || strlen (str + n) >= NAMELEN) return FALSE;
+   strcpy (score->name,str + n);
+   score->timestamp = timestamp;
+   return TRUE;
+}
+
+/* Load the score file and whatever was left in the log */
+static void loadscores ()
+{
+   FILE *handle;
+   char line[NAMELEN + 64];
+   score_t score;
+   int fd;
+   if ((fd = scoredb_lock (dbfile,LOCK_SH)) < 0) die (dbfile);
+   if (!scoredb_load (&db,fd))
+	 {
+		fprintf (stderr,"tintd: %s is corrupt\n",dbfile);
+		exit (EXIT_FAILURE);
+	 }
+   close (fd);
+   if ((logfd = open (logfile,O_RDWR | O_CREAT | O_APPEND,0664)) < 0) die (logfile);
+   if ((handle = fdopen (dup (logfd),"r")) == NULL) die (logfile);
+   while (fgets (line,sizeof (line),handle) != NULL)
+	 {
+		line[strcspn (line,"\n")] = '\0';
+		if (!parsescore (line,&score)) continue;
+		addpending (&score);
+		if (scoredb_find (&db,&score) < 0) scoredb_add (&db,&score);
+	 }
+   fclose (handle);
+   if (!checkpoint ()) fprintf (stderr,"tintd: couldn't update %s\n",dbfile);
+}
+
+static void reply (client_t *client,const char *format, ...)
+{
+   va_list ap;
+   int n;
+   va_start (ap,format);
+   n = vsnprintf (client->out + client->outlen,OUTSIZE - client->outlen,format,ap);
+   va_end (ap);
+   if (n > 0) client->outlen += n;
+   if (client->outlen >= OUTSIZE) client->outlen = OUTSIZE;
+}
+
+static void replyscore (client_t *client,int rank)
+{
+   score_t score;
+   scoredb_get (&db,rank,&score);
+   reply (client,"SCORE %d %d %lld %s\n",rank,score.score,(long long) score.timestamp,score.name);
+}
+
+/* Handle a single request */
+static void request (client_t *client,char *line)
+{
+   score_t score;
+   int n,i;
+   if (strncmp (line,"ADD ",4) == 0 && !client->trusted)
+	 reply (client,"ERR not allowed\n");
+   else if (strncmp (line,"ADD ",4) == 0 && parsescore (line + 4,&score))
+	 {
+		n = snprintf (logbuf + loglen,LOGSIZE - loglen,"%d %lld %s\n",score.score,(long long) score.timestamp,score.name);
+		if (n >= LOGSIZE - loglen)
+		  reply (client,"ERR busy\n");
+		else
+		  {
+			 loglen += n;
+			 addpending (&score);
+			 reply (client,"RANK %d\n",scoredb_add (&db,&score));
+		  }
+	 }
+   else if (sscanf (line,"RANK %d",&n) == 1)
+	 reply (client,"RANK %d\n",scoredb_rank (&db,n));
+   else if (sscanf (line,"TOP %d",&n) == 1)
+	 for (i = 0; i < n && i < SCORED_MAXTOP && i < scoredb_count (&db); i++) replyscore (client,i);
+   else if (strncmp (line,"BEST ",5) == 0)
+	 {
+		if ((n = scoredb_best (&db,line + 5)) >= 0) replyscore (client,n);
+	 }
+   else
+	 reply (client,"ERR unknown request\n");
+   reply (client,"%s\n",SCORED_END);
+}
+
+/* Handle all complete requests of a client. Returns FALSE if the client should be dropped */
+static bool readclient (client_t *client)
+{
+   ssize_t result;
+   char *line,*end;
+   result = read (client->fd,client->in + client->inlen,INSIZE - client->inlen - 1);
+   if (result < 0 && (errno == EINTR || errno == EAGAIN)) return TRUE;
+   if (result <= 0) return FALSE;
+   client->inlen += result;
+   client->in[client->inlen] = '\0';
+   for (line = client->in; (end = strchr (line,'\n')) != NULL; line = end + 1)
+	 {
+		*end = '\0';
+		request (client,line);
+	 }
+   client->inlen -= line - client->in;
+   memmove (client->in,line,client->inlen);
+   /* Requests don't get this long */
+   return (client->inlen < INSIZE - 1 && client->outlen < OUTSIZE);
+}
+
+/* Send as much of the replies as the client takes. Returns FALSE if the client should be dropped */
+static bool writeclient (client_t *client)
+{
+   ssize_t result;
+   if (!client->outlen) return TRUE;
+   result = write (client->fd,client->out,client->outlen);
+   if (result < 0) return (errno == EINTR || errno == EAGAIN);
+   client->outlen -= result;
+   memmove (client->out,client->out + result,client->outlen);
+   return TRUE;
+}
+
+static void dropclient (int i)
+{
+   close (clients[i]->fd);
+   free (clients[i]);
+   clients[i] = clients[--numclients];
+}
+
+static void acceptclient (int listenfd)
+{
+   struct ucred cred;
+   socklen_t len = sizeof (cred);
+   int fd;
+   if ((fd = accept (listenfd,NULL,NULL)) < 0) return;
+   if (numclients == MAXCLIENTS || (clients[numclients] = malloc (sizeof (client_t))) == NULL)
+	 {
+		close (fd);
+		return;
+	 }
+   fcntl (fd,F_SETFL,O_NONBLOCK);
+   clients[numclients]->fd = fd;
+   clients[numclients]->closed = FALSE;
+   /* The socket keeps others out, but don't count on its permissions alone */
+   clients[numclients]->trusted = getsockopt (fd,SOL_SOCKET,SO_PEERCRED,&cred,&len) == 0 &&
+	 (cred.uid == 0 || cred.uid == geteuid () || cred.gid == scoregroup);
+   clients[numclients]->inlen = clients[numclients]->outlen = 0;
+   numclients++;
+}
+
+/* Write this round's log entries. Nothing is acknowledged before they are on disk */
+static void flushlog ()
+{
+   size_t ofs = 0;
+   ssize_t result;
+   while (ofs < loglen)
+	 {
+		if ((result = write (logfd,logbuf + ofs,loglen - ofs)) < 0)
+		  {
+			 if (errno == EINTR) continue;
+			 die (logfile);
+		  }
+		ofs += result;
+	 }
+   if (loglen && fdatasync (logfd) < 0) die (logfile);
+   loglen = 0;
+}
+
+static int listensocket ()
+{
+   struct sockaddr_un addr;
+   struct stat st;
+   mode_t mask;
+   int fd,result;
+   if ((fd = socket (AF_UNIX,SOCK_STREAM,0)) < 0) die ("socket");
+   memset (&addr,0,sizeof (addr));
+   addr.sun_family = AF_UNIX;
+   strncpy (addr.sun_path,socketpath,sizeof (addr.sun_path) - 1);
+   unlink (socketpath);
+   /* Players get in through tint, which is setgid to the group of the score file, like the file itself */
+   if (stat (dbfile,&st) < 0) die (dbfile);
+   scoregroup = st.st_gid;
+   mask = umask (0117);
+   result = bind (fd,(struct sockaddr *) &addr,sizeof (addr));
+   umask (mask);
+   if (result < 0) die (socketpath);
+   if (chown (socketpath,-1,scoregroup) < 0 || chmod (socketpath,0660) < 0) die (socketpath);
+   if (listen (fd,SOMAXCONN) < 0) die (socketpath);
+   return fd;
+}
+
+static void showhelp ()
+{
+   fprintf (stderr,"USAGE: tintd [-h] [-f scorefile] [-s socket]\n");
+   fprintf (stderr,"  -h           Show this help message\n");
+   fprintf (stderr,"  -f <file>    Score file (default %s)\n",SCOREFILE);
+   fprintf (stderr,"  -s <socket>  Socket to listen on (default %s)\n",SCORESOCKET);
+   exit (EXIT_FAILURE);
+}
+
+static void parse_options (int argc,char *argv[])
+{
+   int i = 1;
+   while (i < argc)
+	 {
+		if (strcmp (argv[i],"-f") == 0 && i + 1 < argc)
+		  dbfile = argv[++i];
+		else if (strcmp (argv[i],"-s") == 0 && i + 1 < argc)
+		  socketpath = argv[++i];
+		else
+		  showhelp ();
+		i++;
+	 }
+}
+
+int main (int argc,char *argv[])
+{
+   struct pollfd fds[MAXCLIENTS + 1];
+   time_t lastcheckpoint;
+   int listenfd,i;
+   parse_options (argc,argv);
+   snprintf (logfile,sizeof (logfile),"%s.wal",dbfile);
+   signal (SIGPIPE,SIG_IGN);
+   signal (SIGINT,sighandler);
+   signal (SIGTERM,sighandler);
+   loadscores ();
+   listenfd = listensocket ();
+   lastcheckpoint = time (NULL);
+   while (!finished)
+	 {
+		fds[0].fd = listenfd;
+		fds[0].events = POLLIN;
+		for (i = 0; i < numclients; i++)
+		  {
+			 fds[i + 1].fd = clients[i]->fd;
+			 fds[i + 1].events = clients[i]->outlen ? POLLIN | POLLOUT : POLLIN;
+		  }
+		if (poll (fds,numclients + 1,1000) < 0 && errno != EINTR) die ("poll");
+		/* Read everything that came in, then write the log once for all of it */
+		for (i = 0; i < numclients; i++)
+		  if ((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) && !readclient (clients[i])) clients[i]->closed = TRUE;
+		flushlog ();
+		for (i = numclients - 1; i >= 0; i--)
+		  if (clients[i]->closed || !writeclient (clients[i])) dropclient (i);
+		if (fds[0].revents & POLLIN) acceptclient (listenfd);
+		if (time (NULL) - lastcheckpoint >= CHECKPOINT)
+		  {
+			 if (!checkpoint ()) fprintf (stderr,"tintd: couldn't update %s\n",dbfile);
+			 lastcheckpoint = time (NULL);
+		  }
+	 }
+   close (listenfd);
+   unlink (socketpath);
+   if (!checkpoint ()) fprintf (stderr,"tintd: couldn't update %s\n",dbfile);
+   exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,19 @@
+#!/bin/sh
+
+#
+# Training workload for "make pgo". The games are seeded and the AI
+# looks a fixed number of shapes ahead, so the profile (and the build
+# made from it) comes out the same every time. Usage: train.sh [tint]
+#
+
+set -e
+
+tint=${1:-./tint}
+
+# The engine, the AI and the score function, as fast as they go
+$tint --bench 40 --seed 1
+$tint --bench 10 --seed 1000 -l 5 -n -d
+
+# The same, drawing every move: the board, the status and the ANSI renderer
+$tint --bench 4 --seed 2000 -o ansi -s -d < /dev/null > /dev/null
+$tint --bench 4 --seed 3000 -o ansi -b '#' -n < /dev/null > /dev/null
@@ -0,0 +1,348 @@
+
+/*
+ * Copyright (c) Abraham vd Merwe <abz@blio.net>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *	  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *	  notice, this list of conditions and the following disclaimer in the
+ *	  documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of other contributors
+ *	  may be used to endorse or promote products derived from this software
+ *	  without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tint-tune: tunes the weights of the AI with the noisy cross-entropy
+ * method. Every generation, weight vectors are drawn from a normal
+ * distribution, each one plays the same fixed-seed games, and the
+ * distribution moves to the best of them. The games are spread over all
+ * CPUs with a work-stealing pool, since a good candidate plays far
+ * longer games than a bad one. The distribution is saved after every
+ * generation, so a long run can be stopped and picked up again.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "typedefs.h"
+#include "utils.h"
+#include "engine.h"
+#include "ai.h"
+#include "pool.h"
+
+/*
+ * Macros
+ */
+
+#define DEFAULT_STATE "tint-tune.state"
+
+/* Part of every generation the distribution moves to */
+#define ELITE 0.2
+
+/* Spread of the first generation */
+#define SIGMA 10.0
+
+/* Noise added to the variance, so the search doesn't stop too soon (Szita & Lorincz) */
+#define NOISE(generation) ((generation) < 50 ? 5.0 - (generation) / 10.0 : 0.0)
+
+/*
+ * Type definitions
+ */
+
+/* Everything needed to carry on where we left off */
+typedef struct
+{
+   int generation;
+   uint64_t rng;
+   weights_t mean;
+   double sigma[NUMFEATURES];
+   double best;						/* best fitness so far */
+   weights_t bestweights;
+} state_t;
+
+typedef struct
+{
+   weights_t weights;
+   double fitness;					/* lines per game */
+} candidate_t;
+
+/* One game of one candidate */
+typedef struct
+{
+   const candidate_t *candidate;
+   unsigned int seed;
+   int lines;
+} match_t;
+
+/*
+ * Global variables
+ */
+
+static const char *statefile = DEFAULT_STATE;
+static int population = 50,games = 8,generations = 50,maxpieces = 2000,depth = 1,numthreads;
+static int seed = 1;
+
+/* AI of each thread in the pool */
+static ai_t **ais;
+
+/*
+ * Functions
+ */
+
+static void die (const char *msg)
+{
+   fprintf (stderr,"tint-tune: %s: %s\n",msg,strerror (errno));
+   exit (EXIT_FAILURE);
+}
+
+/* Scores don't matter here, lines do */
+static void score_function (engine_t *engine)
+{
+}
+
+/* Play one game (a job in the pool) */
+static void play (void *arg)
+{
+   match_t *match = arg;
+   ai_t *ai = ais[pool_worker ()];
+   engine_t engine;
+   int pieces = 0;
+   ai_weights (ai,&match->candidate->weights);
+   engine_init (&engine,match->seed,score_function,NULL);
+   while (pieces < maxpieces && ai_play (ai,&engine,0,depth) >= 0) pieces++;
+   match->lines = engine.status.droppedlines;
+}
+
+/* Normally distributed random number */
+static double gaussian (uint64_t *rng)
+{
+   double u = (rand_next (rng,INT_MAX) + 1.0) / ((double) INT_MAX + 1.0);
+   double v = rand_next (rng,INT_MAX) / (double) INT_MAX;
+   return (sqrt (-2.0 * log (u)) * cos (2.0 * M_PI * v));
+}
+
+static int compare (const void *a,const void *b)
+{
+   const candidate_t *x = a,*y = b;
+   return (x->fitness < y->fitness) - (x->fitness > y->fitness);
+}
+
+static void printweights (const char *label,const weights_t *weights)
+{
+   int i;
+   printf ("%s{",label);
+   for (i = 0; i < NUMFEATURES; i++) printf (" %.4f%s",weights->weight[i],i < NUMFEATURES - 1 ? "," : " }\n");
+}
+
+/*
+ * State
+ */
+
+/* Read where we left off. Returns FALSE if there's no state file */
+static bool load (state_t *state)
+{
+   unsigned long long rng;
+   FILE *fp;
+   int i,n;
+   if ((fp = fopen (statefile,"r")) == NULL)
+	 {
+		if (errno == ENOENT) return (FALSE);
+		die (statefile);
+	 }
+   n = fscanf (fp,"generation %d\nrng %llu\nbest %lf\n",&state->generation,&rng,&state->best);
+   for (i = 0; i < NUMFEATURES; i++)
+	 n += fscanf (fp,"%lf %lf %lf\n",&state->mean.weight[i],&state->sigma[i],&state->bestweights.weight[i]);
+   fclose (fp);
+   if (n != 3 + 3 * NUMFEATURES)
+	 {
+		fprintf (stderr,"tint-tune: %s: not a state file\n",statefile);
+		exit (EXIT_FAILURE);
+	 }
+   state->rng = rng;
+   return (TRUE);
+}
+
+/* Save where we are. The old state stays until the new one is complete */
+static void save (const state_t *state)
+{
+   char tmp[PATH_MAX];
+   FILE *fp;
+   int i;
+   snprintf (tmp,sizeof (tmp),"%s.tmp",statefile);
+   if ((fp = fopen (tmp,"w")) == NULL) die (tmp);
+   fprintf (fp,"generation %d\nrng %llu\nbest %.17g\n",state->generation,(unsigned long long) state->rng,state->best);
+   /* mean, sigma and best weights of each feature */
+   for (i = 0; i < NUMFEATURES; i++)
+	 fprintf (fp,"%.17g %.17g %.17g\n",state->mean.weight[i],state->sigma[i],state->bestweights.weight[i]);
+   if (fflush (fp) || fsync (fileno (fp)) || fclose (fp)) die (tmp);
+   if (rename (tmp,statefile)) die (statefile);
+}
+
+/*
+ * Tuning
+ */
+
+static void generation (pool_t *pool,state_t *state)
+{
+   candidate_t *candidate;
+   match_t *match;
+   int elite = population * ELITE,i,j,g;
+   double mean,sum,variance,elitefitness = 0;
+   long long started = microseconds ();
+   if (elite < 1) elite = 1;
+   if ((candidate = malloc (population * sizeof (candidate_t))) == NULL ||
+	   (match = malloc (population * games * sizeof (match_t))) == NULL) die ("malloc");
+   for (i = 0; i < population; i++)
+	 for (j = 0; j < NUMFEATURES; j++)
+	   candidate[i].weights.weight[j] = state->mean.weight[j] + state->sigma[j] * gaussian (&state->rng);
+   /* Everyone plays the same games, which are new every generation */
+   for (i = 0; i < population; i++)
+	 for (g = 0; g < games; g++)
+	   {
+		  match[i * games + g].candidate = &candidate[i];
+		  match[i * games + g].seed = (unsigned int) seed * 1000003u + state->generation * games + g;
+		  pool_submit (pool,play,&match[i * games + g]);
+	   }
+   pool_wait (pool);
+   for (i = 0; i < population; i++)
+	 {
+		for (sum = 0, g = 0; g < games; g++) sum += match[i * games + g].lines;
+		candidate[i].fitness = sum / games;
+	 }
+   /* Move to the best ones */
+   qsort (candidate,population,sizeof (candidate_t),compare);
+   for (j = 0; j < NUMFEATURES; j++)
+	 {
+		for (mean = 0, i = 0; i < elite; i++) mean += candidate[i].weights.weight[j] / elite;
+		for (variance = 0, i = 0; i < elite; i++) variance += (candidate[i].weights.weight[j] - mean) * (candidate[i].weights.weight[j] - mean) / elite;
+		state->mean.weight[j] = mean;
+		state->sigma[j] = sqrt (variance + NOISE (state->generation));
+	 }
+   for (i = 0; i < elite; i++) elitefitness += candidate[i].fitness / elite;
+   if (candidate[0].fitness > state->best)
+	 {
+		state->best = candidate[0].fitness;
+		state->bestweights = candidate[0].weights;
+	 }
+   state->generation++;
+   printf ("generation %d: best %.1f, elite %.1f lines per game (%.1fs)\n",
+		   state->generation,candidate[0].fitness,elitefitness,(microseconds () - started) / 1e6);
+   printweights ("   mean ",&state->mean);
+   fflush (stdout);
+   free (match);
+   free (candidate);
+}
+
+/*
+ * Options
+ */
+
+static void showhelp ()
+{
+   fprintf (stderr,"USAGE: tint-tune [-h] [-f file] [-n generations] [-p population] [-g games] [-m pieces] [-d depth] [-s seed] [-t threads]\n");
+   fprintf (stderr,"  -h               Show this help message\n");
+   fprintf (stderr,"  -f <file>        Save progress to, and carry on from, file (default %s)\n",DEFAULT_STATE);
+   fprintf (stderr,"  -n <generations> Stop after this many generations in total (default %d)\n",generations);
+   fprintf (stderr,"  -p <population>  Weight vectors tried each generation (default %d)\n",population);
+   fprintf (stderr,"  -g <games>       Games each of them plays (default %d)\n",games);
+   fprintf (stderr,"  -m <pieces>      Most shapes in a game (default %d)\n",maxpieces);
+   fprintf (stderr,"  -d <depth>       Shapes the AI looks ahead (1-%d, default %d)\n",AI_MAXDEPTH,depth);
+   fprintf (stderr,"  -s <seed>        Seed for the games (default %d)\n",seed);
+   fprintf (stderr,"  -t <threads>     Number of threads (default: one per CPU)\n");
+   exit (EXIT_FAILURE);
+}
+
+static void parse_options (int argc,char *argv[])
+{
+   int i = 1;
+   while (i < argc)
+	 {
+		if (strcmp (argv[i],"-f") == 0 && i + 1 < argc)
+		  statefile = argv[++i];
+		else if (strcmp (argv[i],"-n") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&generations,argv[++i]) || generations < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-p") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&population,argv[++i]) || population < 2) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-g") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&games,argv[++i]) || games < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-m") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&maxpieces,argv[++i]) || maxpieces < 1) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-d") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&depth,argv[++i]) || depth < 1 || depth > AI_MAXDEPTH) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-s") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&seed,argv[++i])) showhelp ();
+		  }
+		else if (strcmp (argv[i],"-t") == 0 && i + 1 < argc)
+		  {
+			 if (!str2int (&numthreads,argv[++i]) || numthreads < 1) showhelp ();
+		  }
+		else
+		  showhelp ();
+		i++;
+	 }
+}
+
+int main (int argc,char *argv[])
+{
+   state_t state;
+   pool_t *pool;
+   int i;
+   parse_options (argc,argv);
+   if (!numthreads && (numthreads = sysconf (_SC_NPROCESSORS_ONLN)) < 1) numthreads = 1;
+   if (load (&state))
+	 printf ("Carrying on from generation %d in %s\n",state.generation,statefile);
+   else
+	 {
+		memset (&state,0,sizeof (state));
+		state.rng = seed;
+		state.best = -1;
+		for (i = 0; i < NUMFEATURES; i++) state.sigma[i] = SIGMA;
+	 }
+   if ((pool = pool_new (numthreads)) == NULL || (ais = calloc (numthreads,sizeof (ai_t *))) == NULL) die ("pool_new");
+   for (i = 0; i < numthreads; i++)
+	 if ((ais[i] = ai_new (&AI_WEIGHTS)) == NULL) die ("ai_new");
+   while (state.generation < generations)
+	 {
+		generation (pool,&state);
+		save (&state);
+	 }
+   printf ("Best: %.1f lines per game\n",state.best);
+   printweights ("   weights ",&state.bestweights);
+   for (i = 0; i < numthreads; i++) ai_free (ais[i]);
+   free (ais);
+   pool_free (pool);
+   exit (EXIT_SUCCESS);
+}
@@ -33,6 +33,9 @@
  * Boolean definitions
  */
 
+/* The same bool as curses.h, or files that include it disagree with the rest about it */
+#include <stdbool.h>
+
 #ifndef bool
 #define bool int
 #endif
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <limits.h>
+#include <stdint.h>
 
 #include "typedefs.h"
 
@@ -57,6 +58,29 @@ int rand_value (int range)
 #endif
 }
 
+/*
+ * Generate a random number within range with a private generator
+ * (splitmix64)
+ */
+int rand_next (uint64_t *state,int range)
+{
+   uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+   z ^= z >> 31;
+   return ((int) (((z >> 32) * (uint64_t) range) >> 32));
+}
+
+/*
+ * Monotonic clock in microseconds
+ */
+long long microseconds ()
+{
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC,&ts);
+   return ((long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
 /*
  * Convert an str to long. Returns TRUE if successful,
  * FALSE otherwise.
@@ -29,6 +29,8 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdint.h>
+
 #include "typedefs.h"
 
 /*
@@ -41,6 +43,17 @@ void rand_init ();
  */
 int rand_value (int range);
 
+/*
+ * Generate a random number within range with a private generator.
+ * The same seed gives the same numbers on every platform.
+ */
+int rand_next (uint64_t *state,int range);
+
+/*
+ * Monotonic clock in microseconds
+ */
+long long microseconds ();
+
 /*
  * Convert an str to long. Returns TRUE if successful,
  * FALSE otherwise.